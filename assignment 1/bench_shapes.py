@@ -0,0 +1,66 @@
+import os
+import random
+import subprocess
+import sys
+import tempfile
+import time
+
+# (rows, cols) of every benchmarked world: a few very long rows, a few very long columns, and a big square
+SHAPES = {
+    "wide": (4, 100000),
+    "tall": (100000, 4),
+    "fat": (2000, 2000),
+}
+GENERATIONS = 100
+DEFAULT_TILE_SIZES = ["16x256", "4x64", "64x1024"]
+FOLDERS = ["omp", "pthread", "tpool"]
+
+def compile(wDir: str):
+    print("*** Compiling {wDir} ***".format(wDir=wDir))
+    subprocess.run(["make", "clean"], cwd=wDir, capture_output=True)
+    result = subprocess.run(["make", "build"], cwd=wDir, capture_output=True)
+    if (result.returncode != 0):
+        print("Errors: {err}".format(err=result.stderr.decode()))
+        exit(1)
+
+def generate(path: str, nRows: int, nCols: int):
+    rng = random.Random(nRows * nCols)
+    with open(path, "w") as f:
+        f.write("{g}\n{r}\n{c}\n".format(g=GENERATIONS, r=nRows, c=nCols))
+        for _ in range(nRows):
+            f.write(" ".join(str(rng.randint(1, 3)) if rng.random() < 0.3 else "0" for _ in range(nCols)))
+            f.write("\n")
+        f.write("0\n")
+
+def run(wDir: str, inp: str, nThreads: str, tileSize: str):
+    env = dict(os.environ, GOI_TILE_SIZE=tileSize)
+    out = os.path.join(os.path.dirname(inp), "death_toll.out")
+    start = time.perf_counter()
+    result = subprocess.run(["./goi.out", inp, out, nThreads], cwd=wDir, capture_output=True, env=env)
+    elapsed = time.perf_counter() - start
+    if (result.returncode != 0):
+        print("Error: {err}".format(err=result.stderr.decode()))
+        exit(1)
+    with open(out) as f:
+        return elapsed, f.read().strip()
+
+if __name__ == "__main__":
+    if (len(sys.argv) < 2):
+        print("Usage: <nThreads> [<tileSize (e.g. 16x256)>...]")
+        exit()
+
+    nThreads = sys.argv[1]
+    tileSizes = sys.argv[2:] if len(sys.argv) > 2 else DEFAULT_TILE_SIZES
+    for folder in FOLDERS:
+        compile("./{folder}".format(folder=folder))
+
+    with tempfile.TemporaryDirectory() as inputDir:
+        print("*** Running {g} generations with {t} threads ***".format(g=GENERATIONS, t=nThreads))
+        print("{:<8} {:>7} {:>10} {:>10}  {}".format("shape", "backend", "tiles", "time (s)", "death toll"))
+        for shape, (nRows, nCols) in SHAPES.items():
+            inp = os.path.join(inputDir, "{shape}.in".format(shape=shape))
+            generate(inp, nRows, nCols)
+            for folder in FOLDERS:
+                for tileSize in tileSizes:
+                    elapsed, deathToll = run("./{folder}".format(folder=folder), inp, nThreads, tileSize)
+                    print("{:<8} {:>7} {:>10} {:>10.3f}  {}".format(shape, folder, tileSize, elapsed, deathToll))
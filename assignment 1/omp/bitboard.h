@@ -0,0 +1,43 @@
+#ifndef BITBOARD_H
+#define BITBOARD_H
+
+#include <stdint.h>
+#include "grid.h"
+#include "invasion.h"
+#include "stream.h"
+
+/**
+ * A world stored as one bit plane per faction: bit (col % 64) of word (col / 64) of a row of plane f is set iff
+ * that cell belongs to faction f + 1. The dead faction has no plane; a cell is dead iff no plane has it set.
+ *
+ * Every plane has a zeroed halo row above and below the world, and the bits past nCols in the last word of a row
+ * are always 0, so the neighbour words of any cell can be read without bounds checks.
+ *
+ * Only the factions 1 to nPlanes get a plane, where nPlanes is the largest faction that has appeared so far.
+ */
+typedef struct Bitboard {
+    uint64_t *data;
+    int nRows;
+    int nCols;
+    int nWords;
+    int nPlanes;
+} Bitboard;
+
+Bitboard *allocBitboard(int nRows, int nCols, int nPlanes);
+void freeBitboard(Bitboard *board);
+int growBitboard(Bitboard *board, int nPlanes);
+void cellsToBitboard(Bitboard *dst, const cell_t *src);
+void flipInvaders(Bitboard *dst, const InvasionPlan *plan);
+void bitboardToCells(cell_t *dst, const Bitboard *src);
+int nextBitboardRows(const Bitboard *currBoard, const Bitboard *invaders, Bitboard *nextBoard, int rowStart, int rowEnd, uint64_t *liveRows);
+int bitboardGoi(int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions);
+
+/**
+ * Returns a pointer to the first word of row of plane. row may be -1 or nRows to address the halo.
+ */
+static inline uint64_t *bitboardRow(const Bitboard *board, int plane, int row)
+{
+    return board->data + ((long)plane * (board->nRows + 2) + row + 1) * board->nWords;
+}
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+/**
+ * The simulation engines goi can run on. They all produce the same worlds and death toll.
+ */
+typedef enum EngineKind {
+    // PaddedWorld cells, one row segment at a time (see kernel.h)
+    ENGINE_DENSE,
+    // one bit plane per faction, 64 cells per word (see bitboard.h)
+    ENGINE_BITBOARD,
+    // a hash-consed quadtree with memoized successors (see hashlife.h)
+    ENGINE_HASHLIFE,
+    // the live cells and their neighbours only while the world is sparse, and dense otherwise (see sparse.h)
+    ENGINE_SPARSE
+} EngineKind;
+
+EngineKind getEngineKind(void);
+const char *getEngineName(EngineKind kind);
+
+#endif
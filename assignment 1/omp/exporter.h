@@ -2,8 +2,16 @@
 #define DEBUG_H
 
 #include <stdio.h>
+#include "grid.h"
 
+// how many worlds can be waiting to be written before exportWorld waits for the writer
+#define EXPORT_RING_SIZE 4
+// a world of fewer cells is formatted by one thread alone: waking more would take longer than they save
+#define EXPORT_PARALLEL_CELLS (64L * 1024)
+
+void setExportThreads(int nThreads);
 void initWorldExporter(FILE *file);
-void exportWorld(const int *world, int nRows, int nCols);
+void exportWorld(const cell_t *world, int nRows, int nCols);
+void closeWorldExporter(void);
 
 #endif
@@ -7,238 +7,221 @@
 #include "util.h"
 #include "exporter.h"
 #include "settings.h"
+#include "grid.h"
+#include "kernel.h"
+#include "tiles.h"
+#include "cycle.h"
+#include "temporal.h"
+#include "bitboard.h"
+#include "hashlife.h"
+#include "engine.h"
+#include "sparse.h"
+#include "placement.h"
 #include <omp.h>
 
-// including the "dead faction": 0
-#define MAX_FACTIONS 10
-
-// this macro is here to make the code slightly more readable, not because it can be safely changed to
-// any integer value; changing this to a non-zero value may break the code
-#define DEAD_FACTION 0
-
-/**
- * Specifies the number(s) of live neighbors of the same faction required for a dead cell to become alive.
- */
-bool isBirthable(int n)
-{
-    return n == 3;
-}
-
 /**
- * Specifies the number(s) of live neighbors of the same faction required for a live cell to remain alive.
- */
-bool isSurvivable(int n)
-{
-    return n == 2 || n == 3;
-}
-
-/**
- * Specifies the number of live neighbors of a different faction required for a live cell to die due to fighting.
- */
-bool willFight(int n) {
-    return n > 0;
-}
-
-/**
- * Computes and returns the next state of the cell specified by row and col based on currWorld and invaders. Sets *diedDueToFighting to
- * true if this cell should count towards the death toll due to fighting.
+ * The main simulation logic.
  * 
- * invaders can be NULL if there are no invaders.
+ * goi does not own startWorld or invasions and should not modify or attempt to free them. It takes the plan of each
+ * invasion from invasions as the invasion lands (see stream.h).
+ * nThreads is the number of threads to simulate with. It is ignored by the sequential implementation.
+ *
+ * Internally, every world is kept as a PaddedWorld: startWorld is copied in once and invasion plans are read in place.
  */
-int getNextState(const int *currWorld, const int *invaders, int nRows, int nCols, int row, int col, bool *diedDueToFighting)
+int goi(int nThreads, int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions)
 {
-    // we'll explicitly set if it was death due to fighting
-    *diedDueToFighting = false;
-
-    // faction of this cell
-    int cellFaction = getValueAt(currWorld, nRows, nCols, row, col);
+    // set OMP thread count
+    omp_set_num_threads(nThreads);
 
-    // did someone just get landed on?
-    if (invaders != NULL && getValueAt(invaders, nRows, nCols, row, col) != DEAD_FACTION)
+    // the bitboard engine runs the whole simulation on its own, on this thread
+    if (getEngineKind() == ENGINE_BITBOARD)
+    {
+        return bitboardGoi(nGenerations, startWorld, nRows, nCols, invasions);
+    }
+    // and so does the hashlife engine
+    if (getEngineKind() == ENGINE_HASHLIFE)
     {
-        *diedDueToFighting = cellFaction != DEAD_FACTION;
-        return getValueAt(invaders, nRows, nCols, row, col);
+        return hashlifeGoi(nGenerations, startWorld, nRows, nCols, invasions);
     }
 
-    // tracks count of each faction adjacent to this cell
-    int neighborCounts[MAX_FACTIONS];
-    memset(neighborCounts, 0, MAX_FACTIONS * sizeof(int));
+    // pick the fastest row kernel for this CPU
+    initKernel();
 
-    // count neighbors (and self)
-    for (int dy = -1; dy <= 1; dy++)
+    // death toll due to fighting
+    int deathToll = 0;
+    int t, b;
+
+    // init the world!
+    // we make a copy because we do not own startWorld; after this, simulating allocates nothing
+    // every thread of the team is pinned, and each band of rows of the worlds is first touched on the CPU of the
+    // thread with the same number
+    initPlacement(nThreads);
+    #pragma omp parallel
     {
-        for (int dx = -1; dx <= 1; dx++)
-        {
-            int faction = getValueAt(currWorld, nRows, nCols, row + dy, col + dx);
-            if (faction >= DEAD_FACTION)
-            {
-                neighborCounts[faction]++;
-            }
-        }
+        pinThread(omp_get_thread_num());
     }
+    WorldBuffers worlds;
+    if (allocWorldBuffers(&worlds, nRows, nCols) != 0)
+    {
+        return -1;
+    }
+    placeWorldBuffers(&worlds, startWorld, nThreads);
 
-    // we counted this cell as its "neighbor"; adjust for this
-    neighborCounts[cellFaction]--;
+#if REPORT_PLACEMENT
+    reportPlacement();
+#endif
 
-    if (cellFaction == DEAD_FACTION)
+    // only the tiles that can change are recomputed
+    TileMap *tiles = allocTileMap(worlds.curr);
+    // and once the world repeats itself, whole periods are skipped
+    CycleDetector *cycles = allocCycleDetector(nRows, nCols);
+    if (tiles == NULL || cycles == NULL)
     {
-        // this is a dead cell; we need to see if a birth is possible:
-        // need exactly 3 of a single faction; we don't care about other factions
+        freeTileMap(tiles);
+        freeCycleDetector(cycles);
+        freeWorldBuffers(&worlds);
+        return -1;
+    }
 
-        // by default, no birth
-        int newFaction = DEAD_FACTION;
+    // with the sparse engine, a world with few live cells is computed one live cell at a time, on this thread
+    SparseEngine *sparse = NULL;
+    if (getEngineKind() == ENGINE_SPARSE && (sparse = allocSparseEngine(nRows, nCols)) == NULL)
+    {
+        freeCycleDetector(cycles);
+        freeTileMap(tiles);
+        freeWorldBuffers(&worlds);
+        return -1;
+    }
 
-        // start at 1 because we ignore dead neighbors
-        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    // a world too big for the cache is advanced several generations per pass, one block at a time; every thread
+    // advances its blocks in its own scratch worlds
+    int depth = getTemporalDepth(worlds.curr, tiles);
+    TemporalBlocks *blocks = NULL;
+    WorldBuffers *scratch = NULL;
+    if (depth > 1)
+    {
+        blocks = allocTemporalBlocks(tiles, depth);
+        scratch = calloc(nThreads, sizeof(WorldBuffers));
+        bool isReady = blocks != NULL && scratch != NULL;
+        for (int thread = 0; isReady && thread < nThreads; thread++)
         {
-            int count = neighborCounts[faction];
-            if (isBirthable(count))
-            {
-                newFaction = faction;
-            }
+            isReady = initBlockBuffers(&scratch[thread], blocks) == 0;
         }
-
-        return newFaction;
-    }
-    else
-    {
-        /** 
-         * this is a live cell; we follow the usual rules:
-         * Death (fighting): > 0 hostile neighbor
-         * Death (underpopulation): < 2 friendly neighbors and 0 hostile neighbors
-         * Death (overpopulation): > 3 friendly neighbors and 0 hostile neighbors
-         * Survival: 2 or 3 friendly neighbors and 0 hostile neighbors
-         */
-
-        int hostileCount = 0;
-        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+        if (!isReady)
         {
-            if (faction == cellFaction)
+            for (int thread = 0; scratch != NULL && thread < nThreads; thread++)
             {
-                continue;
+                freeWorldBuffers(&scratch[thread]);
             }
-            hostileCount += neighborCounts[faction];
-        }
-
-        if (willFight(hostileCount))
-        {
-            *diedDueToFighting = true;
-            return DEAD_FACTION;
-        }
-
-        int friendlyCount = neighborCounts[cellFaction];
-        if (!isSurvivable(friendlyCount))
-        {
-            return DEAD_FACTION;
+            free(scratch);
+            freeTemporalBlocks(blocks);
+            freeSparseEngine(sparse);
+            freeCycleDetector(cycles);
+            freeTileMap(tiles);
+            freeWorldBuffers(&worlds);
+            return -1;
         }
-
-        return cellFaction;
     }
-}
-
-/**
- * The main simulation logic.
- * 
- * goi does not own startWorld, invasionTimes or invasionPlans and should not modify or attempt to free them.
- * nThreads is the number of threads to simulate with. It is ignored by the sequential implementation.
- */
-int goi(int nThreads, int nGenerations, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans)
-{
-    // set OMP thread count
-    omp_set_num_threads(nThreads);
-
-    // death toll due to fighting
-    int deathToll = 0;
-    int row, col;
-
-    // init the world!
-    // we make a copy because we do not own startWorld (and will perform free() on world)
-    int *world = malloc(sizeof(int) * nRows * nCols);
-    if (world == NULL)
-    {
-        return -1;
-    }
-    memcpy(world, startWorld, nRows * nCols * sizeof(int));
-
-#if PRINT_GENERATIONS
-    printf("\n=== WORLD 0 ===\n");
-    printWorld(world, nRows, nCols);
-#endif
 
-#if EXPORT_GENERATIONS
-    exportWorld(world, nRows, nCols);
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+    outputPaddedWorld(worlds.curr, 0);
 #endif
 
     // Begin simulating
-    int invasionIndex = 0;
     for (int i = 1; i <= nGenerations; i++)
     {
         // is there an invasion this generation?
-        int *inv = NULL;
-        if (invasionIndex < nInvasions && i == invasionTimes[invasionIndex])
+        // its plan is only ever read, and stays valid until the next invasion is taken
+        const InvasionPlan *inv = NULL;
+        if (nextInvasionTime(invasions) == i)
         {
-            // we make a copy because we do not own invasionPlans
-            inv = malloc(sizeof(int) * nRows * nCols);
-            if (inv == NULL)
-            {
-                free(world);
-                return -1;
-            }
-            memcpy(inv, invasionPlans[invasionIndex], nRows * nCols * sizeof(int));
-            invasionIndex++;
+            inv = takeInvasionPlan(invasions);
         }
 
-        // create the next world state
-        int *wholeNewWorld = malloc(sizeof(int) * nRows * nCols);
-        if (wholeNewWorld == NULL)
+        // a sparse world is computed by the sparse engine, which goes back to the dense engine once it fills up
+        bool isSparse = sparse != NULL && nextSparseState(sparse, &worlds, inv, tiles, &deathToll);
+
+        // how many generations to advance by; a pass stops before the next invasion, which gets its own generation
+        int nSteps = 1;
+#if !PRINT_GENERATIONS && !EXPORT_GENERATIONS
+        if (blocks != NULL && inv == NULL && !isSparse)
         {
-            if (inv != NULL)
+            int last = nGenerations;
+            int nextTime = nextInvasionTime(invasions);
+            if (nextTime > i && nextTime <= nGenerations)
             {
-                free(inv);
+                last = nextTime - 1;
             }
-            free(world);
-            return -1;
+            nSteps = last - i + 1 < depth ? last - i + 1 : depth;
         }
+#endif
 
-        // get new states for each cell
-        
-        bool diedDueToFighting;
-        #pragma omp parallel for shared(deathToll, wholeNewWorld) private(row, col, diedDueToFighting)
-        for (row = 0; row < nRows; row++)
+        if (isSparse)
+        {
+            // already computed into worlds.next
+        }
+        else if (nSteps > 1)
         {
-            for (col = 0; col < nCols; col++)
+            planBlocks(blocks, tiles);
+
+#if REPORT_ACTIVE_TILES
+            reportActiveTiles(tiles, i);
+#endif
+
+            // get the states nSteps generations on for each cell of the active blocks; like tiles, blocks report
+            // their own deaths and are handed out dynamically
+            #pragma omp parallel for shared(worlds, tiles, blocks, scratch) private(b) reduction(+:deathToll) schedule(dynamic)
+            for (b = 0; b < blocks->nActive; b++)
             {
-                int nextState = getNextState(world, inv, nRows, nCols, row, col, &diedDueToFighting);
-                setValueAt(wholeNewWorld, nRows, nCols, row, col, nextState);
-                if (diedDueToFighting)
-                {
-                    #pragma omp critical
-                    {
-                        deathToll++;
-                    }
-                }
+                deathToll += nextBlockStates(blocks, blocks->active[b], nSteps, tiles, worlds.curr, worlds.next, &scratch[omp_get_thread_num()]);
             }
+            i += nSteps - 1;
         }
-
-        if (inv != NULL)
+        else
         {
-            free(inv);
-        }
+            planTiles(tiles, inv);
 
-        // swap worlds
-        free(world);
-        world = wholeNewWorld;
-
-#if PRINT_GENERATIONS
-        printf("\n=== WORLD %d ===\n", i);
-        printWorld(world, nRows, nCols);
+#if REPORT_ACTIVE_TILES
+            reportActiveTiles(tiles, i);
 #endif
 
-#if EXPORT_GENERATIONS
-        exportWorld(world, nRows, nCols);
+            // get new states for each cell of the active tiles
+
+            // each tile reports its own deaths, so they can simply be summed; how much work a tile takes varies
+            // (e.g. at the edges), so they are handed out dynamically
+            #pragma omp parallel for shared(worlds, tiles) private(t) reduction(+:deathToll) schedule(dynamic)
+            for (t = 0; t < tiles->nActive; t++)
+            {
+                deathToll += nextTileState(tiles, tiles->active[t], worlds.curr, inv, worlds.next);
+            }
+        }
+
+        // swap worlds
+        swapWorldBuffers(&worlds);
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+        outputPaddedWorld(worlds.curr, i);
+#else
+        // a cycle can only be followed up to the next invasion; every generation is output, so none can be skipped then
+        int target = nGenerations;
+        int nextTime = nextInvasionTime(invasions);
+        if (nextTime > i && nextTime <= nGenerations)
+        {
+            target = nextTime - 1;
+        }
+        i = skipCycles(cycles, worlds.curr, isSparse ? sparse->hash : worldHash(tiles), i, inv != NULL, target, &deathToll);
 #endif
     }
 
-    free(world);
+    for (int thread = 0; scratch != NULL && thread < nThreads; thread++)
+    {
+        freeWorldBuffers(&scratch[thread]);
+    }
+    free(scratch);
+    freeTemporalBlocks(blocks);
+    freeSparseEngine(sparse);
+    freeCycleDetector(cycles);
+    freeTileMap(tiles);
+    freeWorldBuffers(&worlds);
     return deathToll;
 }
@@ -0,0 +1,315 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "input.h"
+#include "parse.h"
+#include "placement.h"
+
+/**
+ * Returns whether fp is an input file of the binary format, i.e. whether it starts with BINARY_INPUT_MAGIC. fp is
+ * left at its start.
+ */
+bool isBinaryInput(FILE *fp)
+{
+    char magic[sizeof(((BinaryHeader *)NULL)->magic)];
+    bool isBinary = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, BINARY_INPUT_MAGIC, sizeof(magic)) == 0;
+    rewind(fp);
+    return isBinary;
+}
+
+/**
+ * Reads fp, an input file of either format, into input: a binary file is mapped with mapBinaryInput, and any other
+ * file is parsed with parseTextInput on up to nThreads threads.
+ *
+ * Returns 0 on success, or -1 after printing what went wrong to stderr. input must then still be freed.
+ */
+int readInput(FILE *fp, int nThreads, GoiInput *input)
+{
+    return isBinaryInput(fp) ? mapBinaryInput(fp, input) : parseTextInput(fp, nThreads, input);
+}
+
+/**
+ * Returns n rounded up to a multiple of 8.
+ */
+static inline uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t)7;
+}
+
+/**
+ * Works out where the invasion times, the invasion index, the start world and the first invaders go in a binary
+ * input file of nRows by nCols with nInvasions.
+ */
+static void binaryLayout(int nRows, int nCols, int nInvasions, uint64_t *timesOffset, uint64_t *indexOffset, uint64_t *worldOffset, uint64_t *invadersOffset)
+{
+    *timesOffset = align8(sizeof(BinaryHeader));
+    *indexOffset = align8(*timesOffset + sizeof(int32_t) * (uint64_t)nInvasions);
+    *worldOffset = align8(*indexOffset + sizeof(BinaryInvasion) * (uint64_t)nInvasions);
+    *invadersOffset = align8(*worldOffset + (uint64_t)nRows * nCols);
+}
+
+/**
+ * Returns whether every one of the nCells cells of world is a faction.
+ */
+static bool isValidWorld(const uint8_t *world, long nCells)
+{
+    for (long i = 0; i < nCells; i++)
+    {
+        if (world[i] >= MAX_FACTIONS)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Returns whether every invader of plan lands a faction on a cell of its world, and whether they are in row-major
+ * order with no cell landed on twice, as the engines expect.
+ */
+static bool isValidPlan(const InvasionPlan *plan)
+{
+    long last = -1;
+    for (long i = 0; i < plan->nInvaders; i++)
+    {
+        const Invader *invader = plan->invaders + i;
+        if (invader->row < 0 || invader->row >= plan->nRows || invader->col < 0 || invader->col >= plan->nCols ||
+            invader->faction <= DEAD_FACTION || invader->faction >= MAX_FACTIONS)
+        {
+            return false;
+        }
+        long cell = (long)invader->row * plan->nCols + invader->col;
+        if (cell <= last)
+        {
+            return false;
+        }
+        last = cell;
+    }
+    return true;
+}
+
+/**
+ * Maps fp, an input file of the binary format, into input. The file is not parsed, but it is checked like a text
+ * input file would be: its header and invasion index, so that nothing past the end of the file is read, then every
+ * cell of its start world and every invader of its invasions.
+ *
+ * Returns 0 on success, or -1 after printing what went wrong to stderr. input must then still be freed.
+ */
+int mapBinaryInput(FILE *fp, GoiInput *input)
+{
+    memset(input, 0, sizeof(GoiInput));
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || (size_t)st.st_size < sizeof(BinaryHeader))
+    {
+        fprintf(stderr, "Failed to read the binary header. Aborting...\n");
+        return -1;
+    }
+    char *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the binary input. Aborting...\n");
+        return -1;
+    }
+    // all of it is read, starting with the start world
+    madvise(mapping, st.st_size, MADV_WILLNEED);
+    input->mapping = mapping;
+    input->mappingSize = st.st_size;
+
+    const BinaryHeader *header = (const BinaryHeader *)mapping;
+    if (header->version != BINARY_INPUT_VERSION || header->nRows <= 0 || header->nCols <= 0 || header->nInvasions < 0)
+    {
+        fprintf(stderr, "Binary input has an unknown version or invalid sizes. Aborting...\n");
+        return -1;
+    }
+    int nRows = header->nRows;
+    int nCols = header->nCols;
+    int nInvasions = header->nInvasions;
+    uint64_t timesOffset, indexOffset, worldOffset, invadersOffset;
+    binaryLayout(nRows, nCols, nInvasions, &timesOffset, &indexOffset, &worldOffset, &invadersOffset);
+    if (invadersOffset > (uint64_t)st.st_size)
+    {
+        fprintf(stderr, "Failed to read STARTING_WORLD. Aborting...\n");
+        return -1;
+    }
+    input->nGenerations = header->nGenerations;
+    input->nRows = nRows;
+    input->nCols = nCols;
+
+    // the start world is used in place if its cells are bytes, and is widened into memory of its own otherwise
+    const uint8_t *world = (const uint8_t *)(mapping + worldOffset);
+    if (!isValidWorld(world, (long)nRows * nCols))
+    {
+        fprintf(stderr, "Failed to read STARTING_WORLD. Aborting...\n");
+        return -1;
+    }
+#if PACKED_CELLS
+    input->startWorld = (cell_t *)world;
+#else
+    input->startWorld = allocPlacedMemory(sizeof(cell_t) * nRows * nCols, true);
+    input->ownsStartWorld = true;
+    if (input->startWorld == NULL)
+    {
+        fprintf(stderr, "Failed to read STARTING_WORLD. Aborting...\n");
+        return -1;
+    }
+    for (long i = 0; i < (long)nRows * nCols; i++)
+    {
+        input->startWorld[i] = world[i];
+    }
+#endif
+
+    input->invasionTimes = (int *)(mapping + timesOffset);
+    input->invasionPlans = calloc(nInvasions, sizeof(InvasionPlan *));
+    if (input->invasionPlans == NULL)
+    {
+        fprintf(stderr, "No memory for invasions. Aborting...\n");
+        return -1;
+    }
+    input->nInvasions = nInvasions;
+    const BinaryInvasion *index = (const BinaryInvasion *)(mapping + indexOffset);
+    for (int i = 0; i < nInvasions; i++)
+    {
+        uint64_t size = index[i].nInvaders * sizeof(Invader);
+        if (index[i].offset < invadersOffset || index[i].offset > (uint64_t)st.st_size || index[i].offset % sizeof(int32_t) != 0 ||
+            index[i].nInvaders > (uint64_t)st.st_size / sizeof(Invader) || index[i].offset + size > (uint64_t)st.st_size)
+        {
+            fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
+            return -1;
+        }
+        input->invasionPlans[i] = viewInvasionPlan(nRows, nCols, (const Invader *)(mapping + index[i].offset), index[i].nInvaders);
+        if (input->invasionPlans[i] == NULL)
+        {
+            fprintf(stderr, "No memory for invasions. Aborting...\n");
+            return -1;
+        }
+        if (!isValidPlan(input->invasionPlans[i]))
+        {
+            fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Writes zeros to fp until it is at offset.
+ */
+static int padTo(FILE *fp, uint64_t offset)
+{
+    static const char zeros[8] = {0};
+    long at = ftell(fp);
+    return at < 0 || (uint64_t)at > offset || fwrite(zeros, 1, offset - at, fp) != offset - at ? -1 : 0;
+}
+
+/**
+ * Writes input to fp in the binary format (see BinaryHeader).
+ *
+ * Returns 0 on success, or -1 if writing failed.
+ */
+int writeBinaryInput(FILE *fp, const GoiInput *input)
+{
+    int nRows = input->nRows;
+    int nCols = input->nCols;
+    int nInvasions = input->nInvasions;
+    uint64_t timesOffset, indexOffset, worldOffset, invadersOffset;
+    binaryLayout(nRows, nCols, nInvasions, &timesOffset, &indexOffset, &worldOffset, &invadersOffset);
+
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_INPUT_MAGIC, sizeof(header.magic));
+    header.version = BINARY_INPUT_VERSION;
+    header.nGenerations = input->nGenerations;
+    header.nRows = nRows;
+    header.nCols = nCols;
+    header.nInvasions = nInvasions;
+    if (fwrite(&header, sizeof(header), 1, fp) != 1 || padTo(fp, timesOffset) != 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < nInvasions; i++)
+    {
+        int32_t time = input->invasionTimes[i];
+        if (fwrite(&time, sizeof(time), 1, fp) != 1)
+        {
+            return -1;
+        }
+    }
+    if (padTo(fp, indexOffset) != 0)
+    {
+        return -1;
+    }
+
+    uint64_t offset = invadersOffset;
+    for (int i = 0; i < nInvasions; i++)
+    {
+        BinaryInvasion invasion;
+        invasion.offset = offset;
+        invasion.nInvaders = input->invasionPlans[i]->nInvaders;
+        if (fwrite(&invasion, sizeof(invasion), 1, fp) != 1)
+        {
+            return -1;
+        }
+        offset += sizeof(Invader) * invasion.nInvaders;
+    }
+    if (padTo(fp, worldOffset) != 0)
+    {
+        return -1;
+    }
+
+#if PACKED_CELLS
+    if (fwrite(input->startWorld, 1, (size_t)nRows * nCols, fp) != (size_t)nRows * nCols)
+    {
+        return -1;
+    }
+#else
+    for (long i = 0; i < (long)nRows * nCols; i++)
+    {
+        if (fputc(input->startWorld[i], fp) == EOF)
+        {
+            return -1;
+        }
+    }
+#endif
+    if (padTo(fp, invadersOffset) != 0)
+    {
+        return -1;
+    }
+
+    for (int i = 0; i < nInvasions; i++)
+    {
+        const InvasionPlan *plan = input->invasionPlans[i];
+        if (fwrite(plan->invaders, sizeof(Invader), plan->nInvaders, fp) != (size_t)plan->nInvaders)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Frees everything input holds, including whatever a failed read left in it.
+ */
+void freeInput(GoiInput *input)
+{
+    for (int i = 0; input->invasionPlans != NULL && i < input->nInvasions; i++)
+    {
+        freeInvasionPlan(input->invasionPlans[i]);
+    }
+    free(input->invasionPlans);
+    if (input->mapping != NULL)
+    {
+        munmap(input->mapping, input->mappingSize);
+    }
+    else
+    {
+        free(input->invasionTimes);
+    }
+    if (input->ownsStartWorld)
+    {
+        freePlacedMemory(input->startWorld);
+    }
+    memset(input, 0, sizeof(GoiInput));
+}
@@ -0,0 +1,68 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "grid.h"
+#include "invasion.h"
+
+// the first 4 bytes of a binary input file; a text input file starts with a digit
+#define BINARY_INPUT_MAGIC "GOIB"
+#define BINARY_INPUT_VERSION 1
+
+/**
+ * The header of a binary input file. Every field is in the byte order of the machine that wrote it.
+ *
+ * The header is followed by, in order and each starting on an 8-byte boundary:
+ * - the invasion times: nInvasions int32_t
+ * - the invasion index: nInvasions BinaryInvasion
+ * - the start world: nRows * nCols cells of one byte each, row by row
+ * - the invaders of every invasion, where its BinaryInvasion points: nInvaders Invader each, in row-major order
+ *
+ * Everything is laid out the way goi reads it, so a mapped file is simulated straight from the mapping: the times
+ * and invaders are used in place, and so is the start world with PACKED_CELLS.
+ */
+typedef struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t nGenerations;
+    int32_t nRows;
+    int32_t nCols;
+    int32_t nInvasions;
+} BinaryHeader;
+
+typedef struct BinaryInvasion {
+    // from the start of the file
+    uint64_t offset;
+    uint64_t nInvaders;
+} BinaryInvasion;
+
+/**
+ * Everything goi is run on, read from an input file of either format.
+ *
+ * A binary file is mapped rather than read (mapping is then set), and the parts of it that goi can use in place are
+ * pointers into the mapping.
+ */
+typedef struct GoiInput {
+    int nGenerations;
+    int nRows;
+    int nCols;
+    cell_t *startWorld;
+    int nInvasions;
+    int *invasionTimes;
+    InvasionPlan **invasionPlans;
+    void *mapping;
+    size_t mappingSize;
+    // whether startWorld was allocated (with allocPlacedMemory) rather than mapped
+    bool ownsStartWorld;
+} GoiInput;
+
+bool isBinaryInput(FILE *fp);
+int readInput(FILE *fp, int nThreads, GoiInput *input);
+int mapBinaryInput(FILE *fp, GoiInput *input);
+int writeBinaryInput(FILE *fp, const GoiInput *input);
+void freeInput(GoiInput *input);
+
+#endif
@@ -0,0 +1,320 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <sched.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+#include "placement.h"
+
+#define HUGE_PAGE_SIZE (2L * 1024 * 1024)
+
+// the length of a mapping is kept in its first cache line, before the memory handed out
+#define PLACEMENT_HEADER_SIZE CACHE_LINE_SIZE
+
+// smaller memory stays in cache, so where it is matters little; it is malloced rather than given a mapping of its
+// own, since a process only gets so many
+#define MIN_MAPPING_SIZE (64L * 1024)
+
+typedef enum HugePages {
+    HUGE_PAGES_OFF,
+    HUGE_PAGES_THP,
+    HUGE_PAGES_HUGETLB
+} HugePages;
+
+static const char *hugePageNames[] = {"off", "thp", "hugetlb"};
+
+// the placement of this process; memory settings are read on the first allocation, the rest by initPlacement
+static struct {
+    bool isMemoryReady;
+    int nNodes;
+    HugePages hugePages;
+    // how the largest mapping so far is backed
+    size_t largestMapping;
+    const char *largestBacking;
+
+    bool isThreadReady;
+    int nThreads;
+    bool isPinned;
+    // the CPUs the process may run on, in order
+    int nCpus;
+    int cpus[CPU_SETSIZE];
+} placement;
+
+/**
+ * Returns the number of NUMA nodes, or 1 if they cannot be told apart.
+ */
+static int countNodes(void)
+{
+    DIR *nodes = opendir("/sys/devices/system/node");
+    if (nodes == NULL)
+    {
+        return 1;
+    }
+    int nNodes = 0;
+    struct dirent *entry;
+    while ((entry = readdir(nodes)) != NULL)
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0 && entry->d_name[4] >= '0' && entry->d_name[4] <= '9')
+        {
+            nNodes++;
+        }
+    }
+    closedir(nodes);
+    return nNodes > 0 ? nNodes : 1;
+}
+
+static void initMemoryPlacement(void)
+{
+    placement.nNodes = countNodes();
+    placement.hugePages = HUGE_PAGES_THP;
+    const char *requested = getenv("GOI_HUGE_PAGES");
+    if (requested != NULL)
+    {
+        for (int hugePages = HUGE_PAGES_OFF; hugePages <= HUGE_PAGES_HUGETLB; hugePages++)
+        {
+            if (strcmp(requested, hugePageNames[hugePages]) == 0)
+            {
+                placement.hugePages = hugePages;
+            }
+        }
+    }
+    placement.largestBacking = "nothing";
+    placement.isMemoryReady = true;
+}
+
+/**
+ * Maps size bytes of zeroed memory, aligned to a cache line, backed as set by GOI_HUGE_PAGES. If isInterleaved, its
+ * pages are spread across all NUMA nodes; otherwise each page goes on the node of the thread that first touches it.
+ * Only the first page is touched here (for the header), and it goes with the start of the memory. Memory smaller
+ * than MIN_MAPPING_SIZE is simply malloced and zeroed here.
+ *
+ * NULL is returned if there is no memory. It must be freed with freePlacedMemory.
+ */
+void *allocPlacedMemory(size_t size, bool isInterleaved)
+{
+    if (!placement.isMemoryReady)
+    {
+        initMemoryPlacement();
+    }
+
+    size_t length = size + PLACEMENT_HEADER_SIZE;
+    if (length < MIN_MAPPING_SIZE)
+    {
+        char *memory;
+        if (posix_memalign((void **)&memory, CACHE_LINE_SIZE, length) != 0)
+        {
+            return NULL;
+        }
+        memset(memory, 0, length);
+        // a length of 0 marks it as malloced
+        *(size_t *)memory = 0;
+        return memory + PLACEMENT_HEADER_SIZE;
+    }
+
+    const char *backing = "4 KiB pages";
+    char *mapping = MAP_FAILED;
+    if (placement.hugePages == HUGE_PAGES_HUGETLB)
+    {
+        size_t hugeLength = (length + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        mapping = mmap(NULL, hugeLength, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (mapping != MAP_FAILED)
+        {
+            length = hugeLength;
+            backing = "hugetlb pages";
+        }
+    }
+    if (mapping == MAP_FAILED)
+    {
+        mapping = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapping == MAP_FAILED)
+        {
+            return NULL;
+        }
+        // smaller mappings cannot hold a huge page anyway
+        if (placement.hugePages != HUGE_PAGES_OFF && length >= HUGE_PAGE_SIZE && madvise(mapping, length, MADV_HUGEPAGE) == 0)
+        {
+            backing = "transparent huge pages";
+        }
+    }
+
+    if (isInterleaved && placement.nNodes > 1)
+    {
+        // the kernel keeps only the nodes the process may use
+        unsigned long nodes = ~0UL;
+        syscall(SYS_mbind, mapping, length, MPOL_INTERLEAVE, &nodes, sizeof(nodes) * 8, 0);
+    }
+
+    if (length > placement.largestMapping)
+    {
+        placement.largestMapping = length;
+        placement.largestBacking = backing;
+    }
+    *(size_t *)mapping = length;
+    return mapping + PLACEMENT_HEADER_SIZE;
+}
+
+void freePlacedMemory(void *memory)
+{
+    if (memory == NULL)
+    {
+        return;
+    }
+    char *mapping = (char *)memory - PLACEMENT_HEADER_SIZE;
+    if (*(size_t *)mapping == 0)
+    {
+        free(mapping);
+        return;
+    }
+    munmap(mapping, *(size_t *)mapping);
+}
+
+/**
+ * Decides whether the nThreads threads of the simulation are pinned, as set by GOI_PIN_THREADS. It must be called
+ * before any thread is pinned, since it reads the CPUs the process may run on.
+ */
+void initPlacement(int nThreads)
+{
+    if (!placement.isMemoryReady)
+    {
+        initMemoryPlacement();
+    }
+    placement.nThreads = nThreads;
+
+    if (!placement.isThreadReady)
+    {
+        cpu_set_t allowed;
+        placement.nCpus = 0;
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        {
+            for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+            {
+                if (CPU_ISSET(cpu, &allowed))
+                {
+                    placement.cpus[placement.nCpus++] = cpu;
+                }
+            }
+        }
+        placement.isThreadReady = true;
+    }
+
+    const char *requested = getenv("GOI_PIN_THREADS");
+    if (requested != NULL && strcmp(requested, "on") == 0)
+    {
+        placement.isPinned = placement.nCpus > 0;
+    }
+    else if (requested != NULL && strcmp(requested, "off") == 0)
+    {
+        placement.isPinned = false;
+    }
+    else
+    {
+        placement.isPinned = nThreads > 1 && nThreads <= placement.nCpus;
+    }
+}
+
+/**
+ * Returns the CPU thread (counted from 0, the main thread) is pinned to, or -1 if threads are not pinned.
+ */
+int getPinnedCpu(int thread)
+{
+    return placement.isPinned ? placement.cpus[thread % placement.nCpus] : -1;
+}
+
+/**
+ * Pins the calling thread, which is the given thread of the simulation, if threads are pinned.
+ */
+void pinThread(int thread)
+{
+    int cpu = getPinnedCpu(thread);
+    if (cpu < 0)
+    {
+        return;
+    }
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    sched_setaffinity(0, sizeof(cpus), &cpus);
+}
+
+typedef struct PlacementArgs {
+    WorldBuffers *buffers;
+    const cell_t *startWorld;
+    int band;
+    int nBands;
+} PlacementArgs;
+
+static void *placeBand(void *args)
+{
+    PlacementArgs *pArgs = (PlacementArgs *)args;
+    pinThread(pArgs->band);
+    placeWorldRows(pArgs->buffers, pArgs->startWorld, pArgs->band, pArgs->nBands);
+    return NULL;
+}
+
+/**
+ * Fills buffers, fresh from allocWorldBuffers, with startWorld, splitting the rows into nThreads bands. Band i is
+ * first touched on the CPU thread i is pinned to, so it lands on that thread's node; the calling thread, which
+ * must be thread 0, does band 0 and pins itself. Threads of the simulation take tiles from anywhere in the world,
+ * but those in their own band of rows are local.
+ *
+ * Returns 0 on success and -1 if a thread cannot be created, in which case the bands are touched by this thread.
+ */
+int placeWorldBuffers(WorldBuffers *buffers, const cell_t *startWorld, int nThreads)
+{
+    if (nThreads <= 1 || !placement.isPinned)
+    {
+        // unpinned threads move around, so there is no telling whose node is whose
+        pinThread(0);
+        placeWorldRows(buffers, startWorld, 0, 1);
+        return 0;
+    }
+
+    pthread_t threads[nThreads];
+    PlacementArgs pArgs[nThreads];
+    int rc = 0;
+    for (int band = 0; band < nThreads; band++)
+    {
+        pArgs[band] = (PlacementArgs){buffers, startWorld, band, nThreads};
+    }
+    for (int band = 1; band < nThreads; band++)
+    {
+        if (pthread_create(&threads[band], NULL, placeBand, &pArgs[band]) != 0)
+        {
+            placeBand(&pArgs[band]);
+            threads[band] = pthread_self();
+            rc = -1;
+        }
+    }
+    placeBand(&pArgs[0]);
+    for (int band = 1; band < nThreads; band++)
+    {
+        if (!pthread_equal(threads[band], pthread_self()))
+        {
+            pthread_join(threads[band], NULL);
+        }
+    }
+    // placeBand pinned this thread as band 0, which is what it is in the simulation too
+    return rc;
+}
+
+/**
+ * Prints how the memory and threads of the simulation were placed to standard output.
+ */
+void reportPlacement(void)
+{
+    printf("Placement: %d NUMA node(s); huge pages: %s, largest mapping (%zu bytes) on %s; ", placement.nNodes, hugePageNames[placement.hugePages], placement.largestMapping, placement.largestBacking);
+    if (placement.isPinned)
+    {
+        printf("%d thread(s) pinned to %d CPU(s), worlds first-touched in %d band(s)\n", placement.nThreads, placement.nCpus, placement.nThreads);
+    }
+    else
+    {
+        printf("%d thread(s) not pinned, worlds first-touched by the main thread\n", placement.nThreads);
+    }
+}
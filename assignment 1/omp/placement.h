@@ -0,0 +1,32 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "grid.h"
+
+/**
+ * Where world memory and threads go on the machine.
+ *
+ * Memory is mapped rather than malloced, so no page of it exists until a thread first writes it. Linux then puts the
+ * page on that thread's NUMA node, so worlds are first touched by the threads that compute them, one band of rows
+ * each (see placeWorldBuffers). Data that every thread reads, such as the start world, is instead interleaved across
+ * nodes.
+ *
+ * GOI_HUGE_PAGES picks the pages that back it: hugetlb asks for explicit huge pages (MAP_HUGETLB) and falls back to
+ * transparent huge pages if there are none; thp (the default) asks for transparent huge pages (MADV_HUGEPAGE); off
+ * leaves it on normal pages. Huge pages cut TLB misses on big worlds.
+ *
+ * GOI_PIN_THREADS pins thread i to the i-th CPU the process may run on: on always pins (wrapping around), off never
+ * does, and if it is unset, threads are pinned if there are at least two and each gets a CPU of its own. A pinned
+ * thread stays next to the memory it first touched.
+ */
+void *allocPlacedMemory(size_t size, bool isInterleaved);
+void freePlacedMemory(void *memory);
+void initPlacement(int nThreads);
+int getPinnedCpu(int thread);
+void pinThread(int thread);
+int placeWorldBuffers(WorldBuffers *buffers, const cell_t *startWorld, int nThreads);
+void reportPlacement(void);
+
+#endif
@@ -29,4 +29,45 @@
  */
 #define PRINT_GENERATIONS 0
 
+/**
+ * If set to 0, every cell is stored as an int.
+ *
+ * If set to a non-zero value, every cell is stored as a uint8_t instead: in the parsed start world and invasion plans,
+ * in the simulation buffers and in the exporter. A faction always fits in a byte, so this only cuts memory use and
+ * bandwidth (by 4x) and packs 4x as many cells into each cache line.
+ */
+#define PACKED_CELLS 1
+
+/**
+ * If set to 0, does nothing.
+ *
+ * If set to a non-zero value, prints how many worlds were allocated over the whole simulation to standard output
+ * once it is done. goi allocates its worlds up front, so this should not grow with the number of generations.
+ */
+#define REPORT_WORLD_ALLOCATIONS 0
+
+/**
+ * If set to 0, does nothing.
+ *
+ * If set to a non-zero value, prints how many tiles of the world are recomputed in every generation to standard output.
+ * Tiles where nothing can change are skipped (see tiles.h).
+ */
+#define REPORT_ACTIVE_TILES 0
+
+/**
+ * If set to 0, does nothing.
+ *
+ * If set to a non-zero value, prints how the worlds and threads were placed on the machine (NUMA nodes, huge pages
+ * and thread pinning) to standard output once the simulation has set up its worlds (see placement.h).
+ */
+#define REPORT_PLACEMENT 0
+
+/**
+ * If set to 0, does nothing.
+ *
+ * If set to a non-zero value, prints how fast a text input file was parsed (in MB/s) to standard output once it has
+ * been (see parse.h).
+ */
+#define REPORT_PARSE_THROUGHPUT 0
+
 #endif
@@ -0,0 +1,56 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "grid.h"
+#include "tiles.h"
+
+// the sparse engine takes over once a world has at most one live cell in this many, and hands it back to the dense
+// engine once it has more than one in SPARSE_LEAVE_CELLS_PER_LIVE; the gap keeps it from switching back and forth
+#define SPARSE_ENTER_CELLS_PER_LIVE 1024
+#define SPARSE_LEAVE_CELLS_PER_LIVE 256
+
+// how many dense generations go by between checks of whether the world has become sparse
+#define SPARSE_CHECK_INTERVAL 64
+
+/**
+ * Computes a sparse world one live cell at a time, while it stays sparse.
+ *
+ * It works on the same WorldBuffers as the dense engine, but only computes the live cells and their neighbours
+ * (its candidates), since any other cell is dead with no live neighbour, and stays dead. getNextState computes each
+ * candidate and landInvader lands each invader on top, as nextRowState does, so the worlds, invasions and deaths are
+ * exactly those of the dense engine. Every cell that is not a candidate or invaded is kept dead in both worlds, so
+ * only the live cells of the world before have to be cleared.
+ *
+ * Live cells are kept as a list of row * nCols + col, and candidates are deduplicated with a bitmap of the world,
+ * so a generation takes time in proportion to the live cells rather than the world.
+ *
+ * When it hands the world back, it resets the TileMap, so the dense engine computes the whole world once and then
+ * goes on skipping tiles as usual.
+ */
+typedef struct SparseEngine {
+    int nRows;
+    int nCols;
+    bool isActive;
+    // dense generations since the world was last checked for sparseness
+    int sinceCheck;
+    // the live cells of the current world, and of the one before it (left in the next world)
+    long *live;
+    long nLive;
+    long *lastLive;
+    long nLastLive;
+    // the cells to compute this generation, marked in a bitmap of the world; both have room for capacity cells
+    long *candidates;
+    long nCandidates;
+    long capacity;
+    uint64_t *marks;
+    // a hash of the current world, the same whatever order its live cells are in
+    uint64_t hash;
+} SparseEngine;
+
+SparseEngine *allocSparseEngine(int nRows, int nCols);
+void freeSparseEngine(SparseEngine *sparse);
+bool nextSparseState(SparseEngine *sparse, WorldBuffers *worlds, const InvasionPlan *inv, TileMap *tiles, int *deathToll);
+
+#endif
@@ -0,0 +1,279 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "stream.h"
+
+/**
+ * Returns whether the GOI_INPUT environment variable asks for the invasions of a text input file to be streamed
+ * (GOI_INPUT=stream) rather than read up front with the rest of it, which is the default.
+ */
+bool isStreamingInput(void)
+{
+    const char *requested = getenv("GOI_INPUT");
+    return requested != NULL && strcmp(requested, "stream") == 0;
+}
+
+/**
+ * Asks for the pages of the invaders of plan, which is a view of a mapped file, to be read from disk ahead of use.
+ */
+static void readAhead(const InvasionPlan *plan)
+{
+    if (plan->nInvaders == 0)
+    {
+        return;
+    }
+    uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)plan->invaders & ~(pageSize - 1);
+    uintptr_t end = (uintptr_t)endInvaders(plan);
+    madvise((void *)start, end - start, MADV_WILLNEED);
+}
+
+/**
+ * Reads the invasions of a streamed file, one at a time: each is read once the one before it has been taken, and its
+ * time is handed over as soon as it is read, ahead of its plan. Once the stream is draining, the rest are read
+ * straight away and only checked. Stops early if one cannot be read or if the stream is closing.
+ */
+static void *readInvasions(void *args)
+{
+    InvasionStream *stream = args;
+    for (int i = 0; i < stream->nInvasions; i++)
+    {
+        // wait for invasion i - 1 to be taken
+        pthread_mutex_lock(&stream->lock);
+        while (stream->hasTime && !stream->isClosing && !stream->isDraining)
+        {
+            pthread_cond_wait(&stream->changed, &stream->lock);
+        }
+        bool isClosing = stream->isClosing;
+        bool isDraining = stream->isDraining;
+        pthread_mutex_unlock(&stream->lock);
+        if (isClosing)
+        {
+            break;
+        }
+
+        int time;
+        const char *error = parseInvasionTime(stream->text, &time);
+        if (isDraining)
+        {
+            // nothing will take this invasion, so its plan is freed as soon as it has been read
+            InvasionPlan *plan = NULL;
+            if (error == NULL)
+            {
+                error = parseInvasionPlan(stream->text, &plan);
+                freeInvasionPlan(plan);
+            }
+            if (error != NULL)
+            {
+                pthread_mutex_lock(&stream->lock);
+                stream->error = error;
+                pthread_mutex_unlock(&stream->lock);
+                break;
+            }
+            continue;
+        }
+        pthread_mutex_lock(&stream->lock);
+        stream->time = time;
+        stream->hasTime = error == NULL;
+        stream->error = error;
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+        if (error != NULL)
+        {
+            break;
+        }
+
+        InvasionPlan *plan = NULL;
+        error = parseInvasionPlan(stream->text, &plan);
+        pthread_mutex_lock(&stream->lock);
+        stream->plan = plan;
+        stream->error = error;
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+        if (error != NULL)
+        {
+            break;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Reads fp, an input file of either format, into input, and opens stream over its invasions (see stream.h). A text
+ * input file is parsed on up to nThreads threads.
+ *
+ * Returns 0 on success, or -1 after printing what went wrong to stderr. input must then still be freed. Otherwise,
+ * stream must be closed before input is freed.
+ */
+int openInvasionStream(FILE *fp, int nThreads, GoiInput *input, InvasionStream *stream)
+{
+    memset(stream, 0, sizeof(InvasionStream));
+    stream->input = input;
+
+    if (!isStreamingInput() || isBinaryInput(fp))
+    {
+        if (readInput(fp, nThreads, input) == -1)
+        {
+            return -1;
+        }
+        stream->nInvasions = input->nInvasions;
+        if (input->mapping != NULL && input->nInvasions > 0)
+        {
+            readAhead(input->invasionPlans[0]);
+        }
+        return 0;
+    }
+
+    stream->text = openTextInput(fp, nThreads, input);
+    if (stream->text == NULL)
+    {
+        return -1;
+    }
+    stream->nInvasions = input->nInvasions;
+    pthread_mutex_init(&stream->lock, NULL);
+    pthread_cond_init(&stream->changed, NULL);
+    if (pthread_create(&stream->reader, NULL, readInvasions, stream) != 0)
+    {
+        fprintf(stderr, "Failed to start reading the invasions. Aborting...\n");
+        pthread_cond_destroy(&stream->changed);
+        pthread_mutex_destroy(&stream->lock);
+        closeTextInput(stream->text);
+        stream->text = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns the time of the next invasion of stream, or -1 if there is none left. If it is streamed, this waits for
+ * its time to be read.
+ *
+ * A streamed invasion that cannot be read is only found out about here, or in takeInvasionPlan, once the simulation
+ * gets to it. The program is then aborted with the message it would have been rejected with up front. Those the
+ * simulation never gets to are checked by finishInvasionStream.
+ */
+int nextInvasionTime(InvasionStream *stream)
+{
+    if (stream->next >= stream->nInvasions)
+    {
+        return -1;
+    }
+    if (stream->text == NULL)
+    {
+        return stream->input->invasionTimes[stream->next];
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    while (!stream->hasTime && stream->error == NULL)
+    {
+        pthread_cond_wait(&stream->changed, &stream->lock);
+    }
+    if (!stream->hasTime)
+    {
+        fputs(stream->error, stderr);
+        exit(EXIT_FAILURE);
+    }
+    int time = stream->time;
+    pthread_mutex_unlock(&stream->lock);
+    return time;
+}
+
+/**
+ * Takes the plan of the next invasion of stream, whose time nextInvasionTime must have returned. If it is streamed,
+ * this waits for its plan to be read, and the plan taken before it is freed: a plan is only valid until the next one
+ * is taken.
+ */
+const InvasionPlan *takeInvasionPlan(InvasionStream *stream)
+{
+    if (stream->text == NULL)
+    {
+        const InvasionPlan *plan = stream->input->invasionPlans[stream->next++];
+        if (stream->input->mapping != NULL && stream->next < stream->nInvasions)
+        {
+            readAhead(stream->input->invasionPlans[stream->next]);
+        }
+        return plan;
+    }
+
+    pthread_mutex_lock(&stream->lock);
+    while (stream->plan == NULL && stream->error == NULL)
+    {
+        pthread_cond_wait(&stream->changed, &stream->lock);
+    }
+    if (stream->plan == NULL)
+    {
+        fputs(stream->error, stderr);
+        exit(EXIT_FAILURE);
+    }
+    InvasionPlan *taken = stream->taken;
+    stream->taken = stream->plan;
+    stream->plan = NULL;
+    stream->hasTime = false;
+    stream->next++;
+    // the reader can go on to the invasion after this one
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+
+    freeInvasionPlan(taken);
+    return stream->taken;
+}
+
+/**
+ * Reads and checks the invasions of stream that were never taken, once the simulation is done, so that a streamed
+ * file is rejected whatever part of it is bad, just as it would have been up front. The invasions of a file that was
+ * read whole have already been checked.
+ *
+ * Returns 0 on success, or -1 after printing what went wrong to stderr. stream must then still be closed.
+ */
+int finishInvasionStream(InvasionStream *stream)
+{
+    if (stream->text == NULL)
+    {
+        return 0;
+    }
+
+    // the reader no longer waits for invasions to be taken, and stops once it has read them all
+    pthread_mutex_lock(&stream->lock);
+    stream->isDraining = true;
+    pthread_cond_broadcast(&stream->changed);
+    pthread_mutex_unlock(&stream->lock);
+    pthread_join(stream->reader, NULL);
+
+    if (stream->error != NULL)
+    {
+        fputs(stream->error, stderr);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Closes stream, stopping its reader if it has one.
+ */
+void closeInvasionStream(InvasionStream *stream)
+{
+    if (stream->text == NULL)
+    {
+        return;
+    }
+
+    // a drained stream's reader has already stopped
+    if (!stream->isDraining)
+    {
+        pthread_mutex_lock(&stream->lock);
+        stream->isClosing = true;
+        pthread_cond_broadcast(&stream->changed);
+        pthread_mutex_unlock(&stream->lock);
+        pthread_join(stream->reader, NULL);
+    }
+
+    freeInvasionPlan(stream->plan);
+    freeInvasionPlan(stream->taken);
+    pthread_cond_destroy(&stream->changed);
+    pthread_mutex_destroy(&stream->lock);
+    closeTextInput(stream->text);
+    stream->text = NULL;
+}
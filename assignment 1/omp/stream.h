@@ -0,0 +1,54 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "input.h"
+#include "invasion.h"
+#include "parse.h"
+
+/**
+ * The invasions of an input file, handed to goi one at a time and in order: nextInvasionTime says when the next one
+ * lands, and takeInvasionPlan takes its plan once it does.
+ *
+ * A stream over a whole input hands out the plans of a GoiInput that has been read up front. With GOI_INPUT=stream,
+ * the invasions of a text input file are streamed instead: the simulation starts as soon as the start world has been
+ * parsed, and a reader thread parses each invasion while the generations before it run, one invasion ahead of the
+ * simulation. At most two plans are then in memory at a time: the one that landed last, and the next. Once the
+ * simulation is done, finishInvasionStream reads the invasions it never got to, so that a bad one is still reported.
+ *
+ * A binary input file is never streamed: it is mapped, so its plans are only read from disk (through its invasion
+ * index) once they are used. Taking a plan of one asks for the next to be read ahead instead.
+ */
+typedef struct InvasionStream {
+    GoiInput *input;
+    int nInvasions;
+    // the next invasion to hand out
+    int next;
+
+    // the rest of a streamed file, or NULL if input was read whole
+    TextInput *text;
+    // the plan of a streamed file taken last, freed when the next is taken
+    InvasionPlan *taken;
+    pthread_t reader;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    // what the reader has read of invasion next so far: its time, then its plan, or what went wrong
+    bool hasTime;
+    int time;
+    InvasionPlan *plan;
+    const char *error;
+    bool isClosing;
+    // set once the simulation is done, after which the reader reads the rest without waiting for them to be taken
+    bool isDraining;
+} InvasionStream;
+
+bool isStreamingInput(void);
+int openInvasionStream(FILE *fp, int nThreads, GoiInput *input, InvasionStream *stream);
+int nextInvasionTime(InvasionStream *stream);
+const InvasionPlan *takeInvasionPlan(InvasionStream *stream);
+int finishInvasionStream(InvasionStream *stream);
+void closeInvasionStream(InvasionStream *stream);
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include "temporal.h"
+#include "kernel.h"
+
+// used when the cache sizes cannot be queried
+#define DEFAULT_L2_CACHE_SIZE (256L * 1024)
+#define DEFAULT_LAST_LEVEL_CACHE_SIZE (8L * 1024 * 1024)
+
+static long cacheSize(int name, long fallback)
+{
+    long size = sysconf(name);
+    return size > 0 ? size : fallback;
+}
+
+/**
+ * Returns the bytes taken by the two worlds of a block of tiles advanced depth generations at a time.
+ */
+static long blockBufferSize(const TileMap *tiles, int depth)
+{
+    int cellsPerLine = CACHE_LINE_SIZE / sizeof(cell_t);
+    long stride = ((long)BLOCK_TILE_COLS * tiles->tileCols + 2 * depth + 2 + cellsPerLine - 1) / cellsPerLine * cellsPerLine;
+    return 2 * sizeof(cell_t) * stride * ((long)BLOCK_TILE_ROWS * tiles->tileRows + 2 * depth + 2);
+}
+
+/**
+ * Returns how many generations to advance world, split into tiles, by per pass, as set by the GOI_TEMPORAL_DEPTH
+ * environment variable. 1 turns temporal blocking off. It is capped at MAX_TEMPORAL_DEPTH and the size of a tile.
+ *
+ * If it is unset or "auto", temporal blocking is only used for worlds whose two buffers do not fit in the last-level
+ * cache, as deep as the worlds of a block still fit in half of L2.
+ */
+int getTemporalDepth(const PaddedWorld *world, const TileMap *tiles)
+{
+    int maxDepth = MAX_TEMPORAL_DEPTH;
+    if (tiles->tileRows < maxDepth)
+    {
+        maxDepth = tiles->tileRows;
+    }
+    if (tiles->tileCols < maxDepth)
+    {
+        maxDepth = tiles->tileCols;
+    }
+
+    const char *requested = getenv("GOI_TEMPORAL_DEPTH");
+    if (requested != NULL && strcmp(requested, "auto") != 0)
+    {
+        int depth = atoi(requested);
+        return depth < 1 ? 1 : depth > maxDepth ? maxDepth : depth;
+    }
+
+    long lastLevelCache = cacheSize(_SC_LEVEL3_CACHE_SIZE, cacheSize(_SC_LEVEL2_CACHE_SIZE, DEFAULT_LAST_LEVEL_CACHE_SIZE));
+    long worldSize = 2 * sizeof(cell_t) * (long)world->stride * (world->nRows + 2);
+    if (worldSize <= lastLevelCache)
+    {
+        return 1;
+    }
+
+    long l2Cache = cacheSize(_SC_LEVEL2_CACHE_SIZE, DEFAULT_L2_CACHE_SIZE);
+    int depth = maxDepth;
+    while (depth > 1 && blockBufferSize(tiles, depth) > l2Cache / 2)
+    {
+        depth--;
+    }
+    return depth;
+}
+
+/**
+ * Allocates the blocks of the world tiles covers, to be advanced up to depth generations at a time.
+ *
+ * NULL is returned if there is no memory.
+ */
+TemporalBlocks *allocTemporalBlocks(const TileMap *tiles, int depth)
+{
+    TemporalBlocks *blocks = malloc(sizeof(TemporalBlocks));
+    if (blocks == NULL)
+    {
+        return NULL;
+    }
+
+    blocks->depth = depth;
+    blocks->blockRows = BLOCK_TILE_ROWS * tiles->tileRows;
+    blocks->blockCols = BLOCK_TILE_COLS * tiles->tileCols;
+    blocks->nBlockRows = (tiles->nTileRows + BLOCK_TILE_ROWS - 1) / BLOCK_TILE_ROWS;
+    blocks->nBlockCols = (tiles->nTileCols + BLOCK_TILE_COLS - 1) / BLOCK_TILE_COLS;
+    blocks->nBlocks = blocks->nBlockRows * blocks->nBlockCols;
+    blocks->nActive = 0;
+    blocks->active = malloc(sizeof(int) * blocks->nBlocks);
+    if (blocks->active == NULL)
+    {
+        free(blocks);
+        return NULL;
+    }
+    return blocks;
+}
+
+void freeTemporalBlocks(TemporalBlocks *blocks)
+{
+    if (blocks == NULL)
+    {
+        return;
+    }
+    free(blocks->active);
+    free(blocks);
+}
+
+/**
+ * Allocates the pair of worlds a block is advanced in. Every thread computing blocks needs its own.
+ *
+ * Returns 0 on success and -1 if there is no memory.
+ */
+int initBlockBuffers(WorldBuffers *scratch, const TemporalBlocks *blocks)
+{
+    scratch->curr = allocPaddedWorld(blocks->blockRows + 2 * blocks->depth, blocks->blockCols + 2 * blocks->depth);
+    scratch->next = allocPaddedWorld(blocks->blockRows + 2 * blocks->depth, blocks->blockCols + 2 * blocks->depth);
+    if (scratch->curr == NULL || scratch->next == NULL)
+    {
+        freeWorldBuffers(scratch);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Works out the blocks to compute in the coming pass from the tiles that changed in the last generation, and resets
+ * changed for the pass, like planTiles does for a single generation. Returns the number of active blocks.
+ *
+ * A block with no active tile can be skipped for up to MAX_TEMPORAL_DEPTH generations: a change spreads by one cell
+ * per generation, and the nearest cell that changed last generation is over a tile away.
+ */
+int planBlocks(TemporalBlocks *blocks, TileMap *tiles)
+{
+    planTiles(tiles, NULL);
+
+    // tiles->active is in ascending order, and so is every block's first tile in it
+    blocks->nActive = 0;
+    memset(blocks->active, 0, sizeof(int) * blocks->nBlocks);
+    for (int t = 0; t < tiles->nActive; t++)
+    {
+        int tile = tiles->active[t];
+        int block = tile / tiles->nTileCols / BLOCK_TILE_ROWS * blocks->nBlockCols + tile % tiles->nTileCols / BLOCK_TILE_COLS;
+        blocks->active[block] = 1;
+    }
+    for (int block = 0; block < blocks->nBlocks; block++)
+    {
+        if (blocks->active[block])
+        {
+            blocks->active[blocks->nActive++] = block;
+        }
+    }
+    return blocks->nActive;
+}
+
+/**
+ * Kills the cells of the one-cell ring around the h by w cells at (0, 0) of world on the sides where they are the
+ * halo of the whole world, since those cells of world are left over from other blocks.
+ */
+static void killWorldEdges(PaddedWorld *world, int h, int w, bool isTop, bool isBottom, bool isLeft, bool isRight)
+{
+    if (isTop)
+    {
+        memset(paddedRow(world, -1) - 1, DEAD_FACTION, sizeof(cell_t) * (w + 2));
+    }
+    if (isBottom)
+    {
+        memset(paddedRow(world, h) - 1, DEAD_FACTION, sizeof(cell_t) * (w + 2));
+    }
+    for (int row = -1; row <= h; row++)
+    {
+        if (isLeft)
+        {
+            setPaddedValueAt(world, row, -1, DEAD_FACTION);
+        }
+        if (isRight)
+        {
+            setPaddedValueAt(world, row, w, DEAD_FACTION);
+        }
+    }
+}
+
+/**
+ * Like nextRowState, but does nothing for an empty range.
+ */
+static int nextSegmentState(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int colStart, int colEnd)
+{
+    return colStart < colEnd ? nextRowState(currWorld, NULL, nextWorld, row, colStart, colEnd) : 0;
+}
+
+/**
+ * Writes the state of block nGenerations generations after currWorld into nextWorld, where nGenerations is at most
+ * blocks->depth and none of them has an invasion, and records which of its tiles changed (rehashing them if so).
+ * Returns the number of cells of the block that died due to fighting over those generations.
+ *
+ * scratch must come from initBlockBuffers. Different blocks can be computed concurrently, each with its own scratch.
+ *
+ * A tile counts as changed if it changed in the last of the generations, so that planTiles knows which tiles can
+ * change next, or if it differs from currWorld, so that a tile that is not changed is the same in both worlds.
+ */
+int nextBlockStates(const TemporalBlocks *blocks, int block, int nGenerations, TileMap *tiles, const PaddedWorld *currWorld, PaddedWorld *nextWorld, WorldBuffers *scratch)
+{
+    int nRows = currWorld->nRows;
+    int nCols = currWorld->nCols;
+
+    int rowStart = block / blocks->nBlockCols * blocks->blockRows;
+    int colStart = block % blocks->nBlockCols * blocks->blockCols;
+    int rowEnd = rowStart + blocks->blockRows < nRows ? rowStart + blocks->blockRows : nRows;
+    int colEnd = colStart + blocks->blockCols < nCols ? colStart + blocks->blockCols : nCols;
+
+    // the block and its ring, clipped to the world, is copied to (0, 0) of scratch
+    int haloTop = rowStart - nGenerations > 0 ? rowStart - nGenerations : 0;
+    int haloLeft = colStart - nGenerations > 0 ? colStart - nGenerations : 0;
+    int haloBottom = rowEnd + nGenerations < nRows ? rowEnd + nGenerations : nRows;
+    int haloRight = colEnd + nGenerations < nCols ? colEnd + nGenerations : nCols;
+    int h = haloBottom - haloTop;
+    int w = haloRight - haloLeft;
+
+    for (int row = 0; row < h; row++)
+    {
+        memcpy(paddedRow(scratch->curr, row), paddedRow(currWorld, haloTop + row) + haloLeft, sizeof(cell_t) * w);
+    }
+    killWorldEdges(scratch->curr, h, w, haloTop == 0, haloBottom == nRows, haloLeft == 0, haloRight == nCols);
+    killWorldEdges(scratch->next, h, w, haloTop == 0, haloBottom == nRows, haloLeft == 0, haloRight == nCols);
+
+    // from here on, everything is in the coordinates of scratch
+    rowStart -= haloTop;
+    rowEnd -= haloTop;
+    colStart -= haloLeft;
+    colEnd -= haloLeft;
+
+    PaddedWorld *from = scratch->curr;
+    PaddedWorld *to = scratch->next;
+    int deaths = 0;
+    for (int generation = 1; generation <= nGenerations; generation++)
+    {
+        // what is left of the ring after this generation
+        int margin = nGenerations - generation;
+        int top = rowStart - margin > 0 ? rowStart - margin : 0;
+        int left = colStart - margin > 0 ? colStart - margin : 0;
+        int bottom = rowEnd + margin < h ? rowEnd + margin : h;
+        int right = colEnd + margin < w ? colEnd + margin : w;
+
+        for (int row = top; row < bottom; row++)
+        {
+            if (row < rowStart || row >= rowEnd)
+            {
+                nextSegmentState(from, to, row, left, right);
+                continue;
+            }
+            nextSegmentState(from, to, row, left, colStart);
+            deaths += nextSegmentState(from, to, row, colStart, colEnd);
+            nextSegmentState(from, to, row, colEnd, right);
+        }
+
+        PaddedWorld *done = from;
+        from = to;
+        to = done;
+    }
+
+    // from now holds the last generation and to the one before it
+    int firstTileRow = block / blocks->nBlockCols * BLOCK_TILE_ROWS;
+    int firstTileCol = block % blocks->nBlockCols * BLOCK_TILE_COLS;
+    for (int tileRow = firstTileRow; tileRow < firstTileRow + BLOCK_TILE_ROWS && tileRow < tiles->nTileRows; tileRow++)
+    {
+        for (int tileCol = firstTileCol; tileCol < firstTileCol + BLOCK_TILE_COLS && tileCol < tiles->nTileCols; tileCol++)
+        {
+            int tile = tileRow * tiles->nTileCols + tileCol;
+            int tileRowStart, tileColStart, tileRowEnd, tileColEnd;
+            tileBounds(tiles, tile, &tileRowStart, &tileColStart, &tileRowEnd, &tileColEnd);
+            size_t rowBytes = sizeof(cell_t) * (tileColEnd - tileColStart);
+
+            bool changed = false;
+            for (int row = tileRowStart; row < tileRowEnd; row++)
+            {
+                const cell_t *last = paddedRow(from, row - haloTop) + tileColStart - haloLeft;
+                const cell_t *beforeLast = paddedRow(to, row - haloTop) + tileColStart - haloLeft;
+                changed = changed || memcmp(last, beforeLast, rowBytes) != 0 || memcmp(last, paddedRow(currWorld, row) + tileColStart, rowBytes) != 0;
+                memcpy(paddedRow(nextWorld, row) + tileColStart, last, rowBytes);
+            }
+
+            if (changed)
+            {
+                markTileChanged(tiles, tile, nextWorld);
+            }
+        }
+    }
+    return deaths;
+}
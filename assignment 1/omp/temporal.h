@@ -0,0 +1,48 @@
+#ifndef TEMPORAL_H
+#define TEMPORAL_H
+
+#include "grid.h"
+#include "tiles.h"
+
+// the size of a block in tiles, so that every tile is in exactly one block
+#define BLOCK_TILE_ROWS 4
+#define BLOCK_TILE_COLS 2
+
+// the most generations a block can be advanced by at once; it is also capped by the tile size (see planBlocks)
+#define MAX_TEMPORAL_DEPTH 16
+
+/**
+ * Advances a world several generations per pass over it, one block at a time (temporal blocking).
+ *
+ * A block is copied into a small pair of worlds together with a ring of depth cells around it (its overlapped halo),
+ * advanced there depth generations, and only then written into the next world. Every generation, the computed area
+ * shrinks by one cell on every side, so the ring is used up exactly when the block itself is done. The pair is small
+ * enough to stay in L2, so a world larger than the last-level cache is streamed through memory once per depth
+ * generations instead of once per generation. Cells of the ring are also computed by the neighbouring blocks, so
+ * only deaths within the block itself are counted.
+ *
+ * Blocks are made of whole tiles and keep the TileMap up to date, so tiles can go on being skipped in between.
+ *
+ * Blocks are numbered row-major like tiles.
+ */
+typedef struct TemporalBlocks {
+    int depth;
+    // the size of a block in cells
+    int blockRows;
+    int blockCols;
+    int nBlockRows;
+    int nBlockCols;
+    int nBlocks;
+    // the blocks to compute in this pass, in ascending order; set by planBlocks
+    int *active;
+    int nActive;
+} TemporalBlocks;
+
+int getTemporalDepth(const PaddedWorld *world, const TileMap *tiles);
+TemporalBlocks *allocTemporalBlocks(const TileMap *tiles, int depth);
+void freeTemporalBlocks(TemporalBlocks *blocks);
+int initBlockBuffers(WorldBuffers *scratch, const TemporalBlocks *blocks);
+int planBlocks(TemporalBlocks *blocks, TileMap *tiles);
+int nextBlockStates(const TemporalBlocks *blocks, int block, int nGenerations, TileMap *tiles, const PaddedWorld *currWorld, PaddedWorld *nextWorld, WorldBuffers *scratch);
+
+#endif
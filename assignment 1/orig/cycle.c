@@ -0,0 +1,85 @@
+#include <stdlib.h>
+#include <limits.h>
+#include "cycle.h"
+
+/**
+ * Allocates a cycle detector for nRows by nCols worlds. It has no snapshot until the first call to skipCycles.
+ *
+ * NULL is returned if there is no memory.
+ */
+CycleDetector *allocCycleDetector(int nRows, int nCols)
+{
+    CycleDetector *cycles = malloc(sizeof(CycleDetector));
+    if (cycles == NULL)
+    {
+        return NULL;
+    }
+    cycles->snapshot = allocPaddedWorld(nRows, nCols);
+    if (cycles->snapshot == NULL)
+    {
+        free(cycles);
+        return NULL;
+    }
+    cycles->snapshotGeneration = -1;
+    return cycles;
+}
+
+void freeCycleDetector(CycleDetector *cycles)
+{
+    if (cycles == NULL)
+    {
+        return;
+    }
+    freePaddedWorld(cycles->snapshot);
+    free(cycles);
+}
+
+/**
+ * Makes world, the given generation with the given death toll, the snapshot to compare against.
+ */
+static void takeSnapshot(CycleDetector *cycles, const PaddedWorld *world, uint64_t hash, int generation, int deathToll)
+{
+    copyPaddedWorld(cycles->snapshot, world);
+    cycles->snapshotHash = hash;
+    cycles->snapshotGeneration = generation;
+    cycles->snapshotDeathToll = deathToll;
+}
+
+/**
+ * Must be called after every generation, with the world it produced (and that world's hash), whether an invasion
+ * landed in it and *deathToll as of it.
+ *
+ * An invasion breaks any cycle, so it restarts the detection. Otherwise, if world is the same as one since the last
+ * invasion, as many whole periods as fit until target are skipped and their deaths added to *deathToll. target is
+ * the last generation that can be skipped to: the one before the next invasion, or the last one.
+ *
+ * Returns the generation the world is now at, which is generation if nothing was skipped.
+ */
+int skipCycles(CycleDetector *cycles, const PaddedWorld *world, uint64_t hash, int generation, bool invaded, int target, int *deathToll)
+{
+    if (invaded || cycles->snapshotGeneration < 0)
+    {
+        takeSnapshot(cycles, world, hash, generation, *deathToll);
+        cycles->limit = 1;
+        return generation;
+    }
+
+    if (hash == cycles->snapshotHash && isSamePaddedWorld(world, cycles->snapshot))
+    {
+        int period = generation - cycles->snapshotGeneration;
+        int periodDeathToll = *deathToll - cycles->snapshotDeathToll;
+        int nPeriods = (target - generation) / period;
+        *deathToll += nPeriods * periodDeathToll;
+        return generation + nPeriods * period;
+    }
+
+    if (generation - cycles->snapshotGeneration >= cycles->limit)
+    {
+        takeSnapshot(cycles, world, hash, generation, *deathToll);
+        if (cycles->limit <= INT_MAX / 2)
+        {
+            cycles->limit *= 2;
+        }
+    }
+    return generation;
+}
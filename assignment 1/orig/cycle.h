@@ -0,0 +1,32 @@
+#ifndef CYCLE_H
+#define CYCLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "grid.h"
+
+/**
+ * Detects when the world repeats itself, so that whole periods of a still life or oscillator can be skipped.
+ *
+ * Between invasions the next world only depends on the current one, so once a world repeats, every later one
+ * does too, with the same period and the same deaths per period. This uses Brent's algorithm: the world is
+ * compared against a single snapshot, which is moved forward whenever the distance to it reaches the next power
+ * of 2. Any cycle is thus found within about twice its start plus its period, with only one extra world.
+ *
+ * Worlds are compared by hash first, and only compared cell by cell when the hashes match.
+ */
+typedef struct CycleDetector {
+    PaddedWorld *snapshot;
+    uint64_t snapshotHash;
+    int snapshotGeneration;
+    // the death toll just after snapshotGeneration
+    int snapshotDeathToll;
+    // how far the world may get from the snapshot before the snapshot is moved up to it
+    int limit;
+} CycleDetector;
+
+CycleDetector *allocCycleDetector(int nRows, int nCols);
+void freeCycleDetector(CycleDetector *cycles);
+int skipCycles(CycleDetector *cycles, const PaddedWorld *world, uint64_t hash, int generation, bool invaded, int target, int *deathToll);
+
+#endif
@@ -0,0 +1,30 @@
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+
+static const char *engineNames[] = {"dense", "bitboard", "hashlife", "sparse"};
+
+/**
+ * Returns the engine selected by the GOI_ENGINE environment variable (dense, bitboard, hashlife or sparse). Defaults to the
+ * dense engine if it is unset or unknown.
+ */
+EngineKind getEngineKind(void)
+{
+    const char *requested = getenv("GOI_ENGINE");
+    if (requested != NULL)
+    {
+        for (int kind = ENGINE_DENSE; kind <= ENGINE_SPARSE; kind++)
+        {
+            if (strcmp(requested, engineNames[kind]) == 0)
+            {
+                return kind;
+            }
+        }
+    }
+    return ENGINE_DENSE;
+}
+
+const char *getEngineName(EngineKind kind)
+{
+    return engineNames[kind];
+}
@@ -0,0 +1,22 @@
+#ifndef HASHLIFE_H
+#define HASHLIFE_H
+
+#include "grid.h"
+#include "invasion.h"
+#include "stream.h"
+
+/**
+ * Runs goi on a hash-consed quadtree, with memoized successors (Gosper's hashlife).
+ *
+ * The world is stored as a tree of square nodes of 2^level by 2^level cells, where equal nodes are always the same
+ * node. The successor of a node (its centre half, some power of 2 generations later) is computed once and then reused
+ * for every copy of that node anywhere in the world and at any time, so worlds made of repeating or settled patterns
+ * are advanced by many generations at once. Every successor carries the fight deaths in each of its quadrants, so the
+ * death toll stays exact.
+ *
+ * Between invasions, the world is advanced by the largest powers of 2 that fit. The generation an invasion lands in
+ * is computed on a PaddedWorld with nextRowState, and the result is turned back into a tree.
+ */
+int hashlifeGoi(int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions);
+
+#endif
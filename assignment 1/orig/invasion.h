@@ -0,0 +1,51 @@
+#ifndef INVASION_H
+#define INVASION_H
+
+#include <stdint.h>
+#include "grid.h"
+
+/**
+ * A cell that an invasion lands on, and the faction that lands there.
+ *
+ * It is laid out the same whatever cell_t is, since binary input files hold invaders as they are (see input.h).
+ */
+typedef struct Invader {
+    int32_t row;
+    int32_t col;
+    int32_t faction;
+} Invader;
+
+/**
+ * An invasion plan of an nRows by nCols world, stored as just the cells it lands on.
+ *
+ * Invasions only land a few cells, so keeping them as a list instead of a whole grid makes them take memory (and
+ * time to apply) in proportion to the cells they land rather than the world. The invaders are in row-major order, so
+ * findInvader can find the ones of any part of a row with a binary search.
+ */
+typedef struct InvasionPlan {
+    int nRows;
+    int nCols;
+    Invader *invaders;
+    long nInvaders;
+    // room for this many invaders is allocated; 0 if the plan views invaders it does not own
+    long capacity;
+} InvasionPlan;
+
+InvasionPlan *allocInvasionPlan(int nRows, int nCols);
+InvasionPlan *viewInvasionPlan(int nRows, int nCols, const Invader *invaders, long nInvaders);
+void freeInvasionPlan(InvasionPlan *plan);
+int addInvader(InvasionPlan *plan, int row, int col, int faction);
+int appendInvaders(InvasionPlan *plan, const InvasionPlan *more);
+const Invader *findInvader(const InvasionPlan *plan, int row, int col);
+int maxInvaderFaction(const InvasionPlan *plan);
+void printInvasionPlan(const InvasionPlan *plan);
+
+/**
+ * Returns a pointer just past the last invader of plan.
+ */
+static inline const Invader *endInvaders(const InvasionPlan *plan)
+{
+    return plan->invaders + plan->nInvaders;
+}
+
+#endif
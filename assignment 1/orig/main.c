@@ -15,29 +15,22 @@
 #include "util.h"
 #include "exporter.h"
 #include "settings.h"
+#include "placement.h"
+#include "input.h"
+#include "stream.h"
 #include "goi.h"
 
-int readParam(FILE *fp, char **line, size_t *len, int *param);
-int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols);
-
 /**
  * Handles input, output and file open/close operations. Delegates simulation to goi.
  */
 int main(int argc, char *argv[])
 {
-    int nGenerations;
-    int nRows;
-    int nCols;
-    int *startWorld;
-    int nInvasions;
-    int *invasionTimes;
-    int **invasionPlans;
+    GoiInput input;
+    InvasionStream invasions;
     int nThreads;
 
     FILE *outputFile;
     FILE *inputFile;
-    char *line = NULL;
-    size_t len = 0;
 
     if (argc < 4)
     {
@@ -59,7 +52,6 @@ int main(int argc, char *argv[])
     {
         printf("<OPT_EXPORT_PATH>: %s\n", argv[4]);
         exportFile = fopen(argv[4], "w");
-        initWorldExporter(exportFile);
     }
 #endif
 
@@ -89,159 +81,60 @@ int main(int argc, char *argv[])
         exit(EXIT_FAILURE);
     }
 
-    // Read nGenerations
-    if (readParam(inputFile, &line, &len, &nGenerations) == -1)
-    {
-        fprintf(stderr, "Failed to read N_GENERATIONS. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Read nRows
-    if (readParam(inputFile, &line, &len, &nRows) == -1)
-    {
-        fprintf(stderr, "Failed to read N_ROWS. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Read nCols
-    if (readParam(inputFile, &line, &len, &nCols) == -1)
-    {
-        fprintf(stderr, "Failed to read N_COLS. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
-
-    if (nRows == 0 || nCols == 0)
-    {
-        fprintf(stderr, "N_ROWS or N_COLS is 0. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Read start world
-    startWorld = malloc(sizeof(int) * nRows * nCols);
-    if (startWorld == NULL || readWorldLayout(inputFile, &line, &len, startWorld, nRows, nCols) == -1)
-    {
-        fprintf(stderr, "Failed to read STARTING_WORLD. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
-
-    // Read nInvasions
-    if (readParam(inputFile, &line, &len, &nInvasions) == -1)
-    {
-        fprintf(stderr, "Failed to read N_INVASIONS. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
+#if EXPORT_GENERATIONS
+    // the worlds are formatted on as many threads as they are simulated on
+    setExportThreads(nThreads);
+    initWorldExporter(exportFile);
+#endif
 
-    // Read invasions
-    invasionTimes = malloc(sizeof(int) * nInvasions);
-    invasionPlans = malloc(sizeof(int *) * nInvasions);
-    if (invasionTimes == NULL || invasionPlans == NULL)
+    // Read the input with as many threads as the simulation; a binary input file is mapped rather than parsed, and
+    // with GOI_INPUT=stream, the invasions of a text one are only read as the simulation gets to them
+    if (openInvasionStream(inputFile, nThreads, &input, &invasions) == -1)
     {
-        fprintf(stderr, "No memory for invasions. Aborting...\n");
         exit(EXIT_FAILURE);
     }
-    for (int i = 0; i < nInvasions; i++)
-    {
-        if (invasionTimes == NULL || readParam(inputFile, &line, &len, invasionTimes + i))
-        {
-            fprintf(stderr, "Failed to read INVASION_TIME. Aborting...\n");
-            exit(EXIT_FAILURE);
-        }
-
-        invasionPlans[i] = malloc(sizeof(int) * nRows * nCols);
-        if (invasionPlans[i] == NULL || readWorldLayout(inputFile, &line, &len, invasionPlans[i], nRows, nCols))
-        {
-            fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
-            exit(EXIT_FAILURE);
-        }
-    }
 
 #if PRINT_GENERATIONS
-    printf("N_GENERATIONS: %d, N_ROWS: %d, N_COLS: %d, N_INVASIONS: %d\n", nGenerations, nRows, nCols, nInvasions);
+    printf("N_GENERATIONS: %d, N_ROWS: %d, N_COLS: %d, N_INVASIONS: %d\n", input.nGenerations, input.nRows, input.nCols, input.nInvasions);
     printf("\n== STARTING_WORLD ==\n");
-    printWorld(startWorld, nRows, nCols);
-    for (int i = 0; i < nInvasions; i++)
+    printWorld(input.startWorld, input.nRows, input.nCols);
+    for (int i = 0; input.invasionPlans != NULL && i < input.nInvasions; i++)
     {
-        printf("\n== invasion %d at time: %d ==\n", i, invasionTimes[i]);
-        printWorld(invasionPlans[i], nRows, nCols);
+        printf("\n== invasion %d at time: %d ==\n", i, input.invasionTimes[i]);
+        printInvasionPlan(input.invasionPlans[i]);
     }
 #endif
 
-    // we're done with the file
+    // we're done with the file; a mapping of it outlives it
     fclose(inputFile);
-    if (line)
-    {
-        free(line);
-    }
 
     // run the simulation
-    int warDeathToll = goi(nThreads, nGenerations, startWorld, nRows, nCols, nInvasions, invasionTimes, invasionPlans);
+    int warDeathToll = goi(nThreads, input.nGenerations, input.startWorld, input.nRows, input.nCols, &invasions);
+
+    // a streamed file is only rejected once it has all been read, including any invasions after the last generation
+    if (finishInvasionStream(&invasions) == -1)
+    {
+        exit(EXIT_FAILURE);
+    }
 
     // output the result
     fprintf(outputFile, "%d", warDeathToll);
     fclose(outputFile);
 
+#if REPORT_WORLD_ALLOCATIONS
+    printf("World allocations: %ld\n", getWorldAllocationCount());
+#endif
+
 #if EXPORT_GENERATIONS
     if (exportFile != NULL)
     {
+        // every generation is written before the file is closed
+        closeWorldExporter();
         fclose(exportFile);
     }
 #endif
 
     // free everything!
-    for (int i = 0; i < nInvasions; i++)
-    {
-        free(invasionPlans[i]);
-    }
-    free(invasionTimes);
-    free(invasionPlans);
-    free(startWorld);
-}
-
-// readParam reads one integer from a line into param, advancing the read head to the next line.
-// -1 is returned on error.
-int readParam(FILE *fp, char **line, size_t *len, int *param)
-{
-    if (getline(line, len, fp) == -1 ||
-        sscanf(*line, "%d", param) != 1)
-    {
-        return -1;
-    }
-    return 0;
-}
-
-// readWorldLayout reads a world layout specified by nRows and nCols, advancing the read head by
-// nRows number of lines. -1 is returned on error.
-int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols)
-{
-    for (int row = 0; row < nRows; row++)
-    {
-        if (getline(line, len, fp) == -1)
-        {
-            return -1;
-        }
-
-        char *p = *line;
-        for (int col = 0; col < nCols; col++)
-        {
-            char *end;
-            int cell = strtol(p, &end, 10);
-
-            // unexpected end
-            if (cell == 0 && end == p)
-            {
-                return -1;
-            }
-
-            // other errors
-            if (errno == EINVAL || errno == ERANGE)
-            {
-                return -1;
-            }
-
-            setValueAt(world, nRows, nCols, row, col, cell);
-            p = end;
-        }
-    }
-
-    return 0;
+    closeInvasionStream(&invasions);
+    freeInput(&input);
 }
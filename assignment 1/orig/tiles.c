@@ -0,0 +1,245 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include "tiles.h"
+#include "kernel.h"
+
+/**
+ * Returns the first row and column of tile, and one past its last ones, in *rowStart, *colStart, *rowEnd and *colEnd.
+ */
+void tileBounds(const TileMap *tiles, int tile, int *rowStart, int *colStart, int *rowEnd, int *colEnd)
+{
+    *rowStart = tile / tiles->nTileCols * tiles->tileRows;
+    *colStart = tile % tiles->nTileCols * tiles->tileCols;
+    *rowEnd = *rowStart + tiles->tileRows < tiles->nRows ? *rowStart + tiles->tileRows : tiles->nRows;
+    *colEnd = *colStart + tiles->tileCols < tiles->nCols ? *colStart + tiles->tileCols : tiles->nCols;
+}
+
+/**
+ * Returns a hash of the cells of tile in world. The same cells in different tiles hash differently.
+ */
+static uint64_t hashTile(const TileMap *tiles, int tile, const PaddedWorld *world)
+{
+    int rowStart, colStart, rowEnd, colEnd;
+    tileBounds(tiles, tile, &rowStart, &colStart, &rowEnd, &colEnd);
+    size_t rowBytes = sizeof(cell_t) * (colEnd - colStart);
+
+    // FNV-1a, but over 8 bytes at a time
+    uint64_t hash = 0xcbf29ce484222325ULL ^ (uint64_t)tile;
+    for (int row = rowStart; row < rowEnd; row++)
+    {
+        const unsigned char *bytes = (const unsigned char *)(paddedRow(world, row) + colStart);
+        for (size_t i = 0; i < rowBytes; i += sizeof(uint64_t))
+        {
+            uint64_t word = 0;
+            memcpy(&word, bytes + i, rowBytes - i < sizeof(uint64_t) ? rowBytes - i : sizeof(uint64_t));
+            hash = (hash ^ word) * 0x100000001b3ULL;
+        }
+    }
+    return hash;
+}
+
+/**
+ * Sets the tile size of tiles from the GOI_TILE_SIZE environment variable (<rows>x<cols>), or to TILE_ROWS by
+ * TILE_COLS if it is unset or invalid.
+ */
+static void setTileSize(TileMap *tiles)
+{
+    tiles->tileRows = TILE_ROWS;
+    tiles->tileCols = TILE_COLS;
+
+    const char *requested = getenv("GOI_TILE_SIZE");
+    int tileRows, tileCols;
+    if (requested != NULL && sscanf(requested, "%dx%d", &tileRows, &tileCols) == 2 && tileRows > 0 && tileCols > 0)
+    {
+        tiles->tileRows = tileRows;
+        tiles->tileCols = tileCols;
+    }
+}
+
+/**
+ * Allocates the tile map of world and hashes its tiles. Every tile starts out changed, so the first generation
+ * computes the whole world.
+ *
+ * NULL is returned if there is no memory.
+ */
+TileMap *allocTileMap(const PaddedWorld *world)
+{
+    TileMap *tiles = malloc(sizeof(TileMap));
+    if (tiles == NULL)
+    {
+        return NULL;
+    }
+
+    int nRows = world->nRows;
+    int nCols = world->nCols;
+
+    tiles->nRows = nRows;
+    tiles->nCols = nCols;
+    setTileSize(tiles);
+    tiles->nTileRows = (nRows + tiles->tileRows - 1) / tiles->tileRows;
+    tiles->nTileCols = (nCols + tiles->tileCols - 1) / tiles->tileCols;
+    tiles->nTiles = tiles->nTileRows * tiles->nTileCols;
+    tiles->nActive = 0;
+    tiles->changed = malloc(sizeof(uint8_t) * tiles->nTiles);
+    tiles->hash = malloc(sizeof(uint64_t) * tiles->nTiles);
+    tiles->active = malloc(sizeof(int) * tiles->nTiles);
+    tiles->invaded = calloc(tiles->nTiles, sizeof(uint8_t));
+    if (tiles->changed == NULL || tiles->hash == NULL || tiles->active == NULL || tiles->invaded == NULL)
+    {
+        freeTileMap(tiles);
+        return NULL;
+    }
+    resetTileMap(tiles, world);
+    return tiles;
+}
+
+/**
+ * Rehashes every tile of world and marks them all changed, for when world was computed without tiles keeping track
+ * (e.g. by the sparse engine). The next generation then computes the whole world.
+ */
+void resetTileMap(TileMap *tiles, const PaddedWorld *world)
+{
+    memset(tiles->changed, 1, sizeof(uint8_t) * tiles->nTiles);
+    for (int tile = 0; tile < tiles->nTiles; tile++)
+    {
+        tiles->hash[tile] = hashTile(tiles, tile, world);
+    }
+}
+
+void freeTileMap(TileMap *tiles)
+{
+    if (tiles == NULL)
+    {
+        return;
+    }
+    free(tiles->changed);
+    free(tiles->hash);
+    free(tiles->active);
+    free(tiles->invaded);
+    free(tiles);
+}
+
+/**
+ * Returns the tile that the cell at row and col is in.
+ */
+static inline int tileOf(const TileMap *tiles, int row, int col)
+{
+    return row / tiles->tileRows * tiles->nTileCols + col / tiles->tileCols;
+}
+
+/**
+ * Works out the active tiles of the coming generation from the tiles that changed in the last one and the
+ * invasionPlan landing in it (NULL if there is none), and resets changed for the coming generation.
+ *
+ * An invaded tile is marked changed for the coming generation even if it ends up the same: its invaded cells did
+ * not follow the rules, so they can change in the generation after without any neighbour changing.
+ *
+ * Must be called between generations, by one thread. Returns the number of active tiles.
+ */
+int planTiles(TileMap *tiles, const InvasionPlan *invasionPlan)
+{
+    // only the tiles the invaders are in are invaded, so the others need not be looked at
+    for (long i = 0; invasionPlan != NULL && i < invasionPlan->nInvaders; i++)
+    {
+        tiles->invaded[tileOf(tiles, invasionPlan->invaders[i].row, invasionPlan->invaders[i].col)] = 1;
+    }
+
+    tiles->nActive = 0;
+    for (int tileRow = 0; tileRow < tiles->nTileRows; tileRow++)
+    {
+        for (int tileCol = 0; tileCol < tiles->nTileCols; tileCol++)
+        {
+            int tile = tileRow * tiles->nTileCols + tileCol;
+
+            // did this tile or a neighbouring one change?
+            bool isActive = false;
+            for (int dy = -1; dy <= 1 && !isActive; dy++)
+            {
+                for (int dx = -1; dx <= 1 && !isActive; dx++)
+                {
+                    int y = tileRow + dy;
+                    int x = tileCol + dx;
+                    if (y >= 0 && y < tiles->nTileRows && x >= 0 && x < tiles->nTileCols)
+                    {
+                        isActive = tiles->changed[y * tiles->nTileCols + x];
+                    }
+                }
+            }
+
+            if (isActive || tiles->invaded[tile])
+            {
+                tiles->active[tiles->nActive++] = tile;
+            }
+        }
+    }
+
+    memset(tiles->changed, 0, sizeof(uint8_t) * tiles->nTiles);
+    for (long i = 0; invasionPlan != NULL && i < invasionPlan->nInvaders; i++)
+    {
+        int tile = tileOf(tiles, invasionPlan->invaders[i].row, invasionPlan->invaders[i].col);
+        tiles->changed[tile] = 1;
+        tiles->invaded[tile] = 0;
+    }
+    return tiles->nActive;
+}
+
+/**
+ * Writes the next state of tile into nextWorld, like nextRowState does for every row of it, and records whether
+ * it changed (rehashing it if so). Returns the number of cells of the tile that died due to fighting.
+ *
+ * Different tiles can be computed concurrently.
+ */
+int nextTileState(TileMap *tiles, int tile, const PaddedWorld *currWorld, const InvasionPlan *invaders, PaddedWorld *nextWorld)
+{
+    int rowStart, colStart, rowEnd, colEnd;
+    tileBounds(tiles, tile, &rowStart, &colStart, &rowEnd, &colEnd);
+
+    int deaths = 0;
+    bool changed = false;
+    for (int row = rowStart; row < rowEnd; row++)
+    {
+        deaths += nextRowState(currWorld, invaders, nextWorld, row, colStart, colEnd);
+        changed = changed || memcmp(paddedRow(currWorld, row) + colStart, paddedRow(nextWorld, row) + colStart, sizeof(cell_t) * (colEnd - colStart)) != 0;
+    }
+
+    if (changed)
+    {
+        tiles->changed[tile] = 1;
+        tiles->hash[tile] = hashTile(tiles, tile, nextWorld);
+    }
+    return deaths;
+}
+
+/**
+ * Records that tile changed in a generation that was not computed by nextTileState, and rehashes it from world,
+ * which must already hold its new cells.
+ */
+void markTileChanged(TileMap *tiles, int tile, const PaddedWorld *world)
+{
+    tiles->changed[tile] = 1;
+    tiles->hash[tile] = hashTile(tiles, tile, world);
+}
+
+/**
+ * Returns a hash of the whole world the tile hashes were last updated for. Two worlds with different hashes differ,
+ * but ones with the same hash still need to be compared to be sure.
+ */
+uint64_t worldHash(const TileMap *tiles)
+{
+    uint64_t hash = 0;
+    for (int tile = 0; tile < tiles->nTiles; tile++)
+    {
+        hash += tiles->hash[tile];
+    }
+    return hash;
+}
+
+/**
+ * Prints how many tiles are active in the given generation to standard output.
+ */
+void reportActiveTiles(const TileMap *tiles, int generation)
+{
+    printf("Generation %d: %d of %d tiles active\n", generation, tiles->nActive, tiles->nTiles);
+}
@@ -0,0 +1,57 @@
+#ifndef TILES_H
+#define TILES_H
+
+#include <stdint.h>
+#include "grid.h"
+#include "invasion.h"
+
+// the default size of a tile in cells; the tiles along the bottom and right edges of the world may be smaller
+#define TILE_ROWS 16
+#define TILE_COLS 256
+
+/**
+ * Tracks which tiles of a world can change this generation, so that only those are recomputed.
+ *
+ * A tile is active if it or one of its 8 neighbouring tiles changed last generation, or if an invasion lands on it.
+ * Any other tile is quiescent: all its inputs are the same as last generation, so it keeps its state and cannot have
+ * anyone die fighting. Skipping it is safe with WorldBuffers because a quiescent tile is also the same in both worlds.
+ *
+ * Tiles are numbered row-major: tile t covers tile row t / nTileCols and tile column t % nTileCols.
+ *
+ * Tiles are also the unit of work of the parallel backends, so that worlds of any shape split into enough of them:
+ * a world of a few very long rows is cut across its columns, not just its rows. Their size can be set with the
+ * GOI_TILE_SIZE environment variable, as <rows>x<cols> (e.g. 16x256).
+ *
+ * Every tile also keeps a hash of its cells, updated whenever it changes, so that worldHash can hash the whole world
+ * without reading it.
+ */
+typedef struct TileMap {
+    int nRows;
+    int nCols;
+    int tileRows;
+    int tileCols;
+    int nTileRows;
+    int nTileCols;
+    int nTiles;
+    // changed[t] is set by nextTileState if tile t changed this generation
+    uint8_t *changed;
+    // hash[t] is the hash of the current cells of tile t
+    uint64_t *hash;
+    // the tiles to compute this generation, in ascending order; set by planTiles
+    int *active;
+    int nActive;
+    // invaded[t] is set by planTiles while it works out whether an invader lands on tile t; otherwise all 0
+    uint8_t *invaded;
+} TileMap;
+
+TileMap *allocTileMap(const PaddedWorld *world);
+void freeTileMap(TileMap *tiles);
+void resetTileMap(TileMap *tiles, const PaddedWorld *world);
+int planTiles(TileMap *tiles, const InvasionPlan *invasionPlan);
+void tileBounds(const TileMap *tiles, int tile, int *rowStart, int *colStart, int *rowEnd, int *colEnd);
+int nextTileState(TileMap *tiles, int tile, const PaddedWorld *currWorld, const InvasionPlan *invaders, PaddedWorld *nextWorld);
+void markTileChanged(TileMap *tiles, int tile, const PaddedWorld *world);
+uint64_t worldHash(const TileMap *tiles);
+void reportActiveTiles(const TileMap *tiles, int generation);
+
+#endif
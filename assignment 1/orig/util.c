@@ -8,13 +8,15 @@
 
 #include "util.h"
 #include <stdio.h>
+#include "exporter.h"
+#include "settings.h"
 
 /**
  * returns the value at the input row and col of the input grid, if valid.
  * 
  * -1 is returned if row or col is out of bounds (as specified by nRows and nCols).
  */
-int getValueAt(const int *grid, int nRows, int nCols, int row, int col)
+int getValueAt(const cell_t *grid, int nRows, int nCols, int row, int col)
 {
     if (row < 0 || row >= nRows || col < 0 || col >= nCols)
     {
@@ -29,7 +31,7 @@ int getValueAt(const int *grid, int nRows, int nCols, int row, int col)
  * 
  * Does nothing if row or col is out of bounds (as specified by nRows and nCols).
  */
-void setValueAt(int *grid, int nRows, int nCols, int row, int col, int val)
+void setValueAt(cell_t *grid, int nRows, int nCols, int row, int col, int val)
 {
     if (row < 0 || row >= nRows || col < 0 || col >= nCols)
     {
@@ -42,7 +44,7 @@ void setValueAt(int *grid, int nRows, int nCols, int row, int col, int val)
 /**
  * Writes the input world to stdout.
  */
-void printWorld(const int *world, int nRows, int nCols)
+void printWorld(const cell_t *world, int nRows, int nCols)
 {
     for (int row = 0; row < nRows; row++)
     {
@@ -53,3 +55,18 @@ void printWorld(const int *world, int nRows, int nCols)
         printf("\n");
     }
 }
+
+/**
+ * Prints and/or exports the input world as the given generation, depending on settings.h.
+ */
+void outputWorld(const cell_t *world, int nRows, int nCols, int generation)
+{
+#if PRINT_GENERATIONS
+    printf("\n=== WORLD %d ===\n", generation);
+    printWorld(world, nRows, nCols);
+#endif
+
+#if EXPORT_GENERATIONS
+    exportWorld(world, nRows, nCols);
+#endif
+}
@@ -0,0 +1,420 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "bitboard.h"
+#include "util.h"
+#include "settings.h"
+
+#define WORD_BITS 64
+
+/**
+ * Allocates a zeroed (i.e. entirely dead) bitboard of nRows by nCols with planes for the factions 1 to nPlanes.
+ *
+ * NULL is returned if there is no memory.
+ */
+Bitboard *allocBitboard(int nRows, int nCols, int nPlanes)
+{
+    Bitboard *board = malloc(sizeof(Bitboard));
+    if (board == NULL)
+    {
+        return NULL;
+    }
+
+    board->nRows = nRows;
+    board->nCols = nCols;
+    board->nWords = (nCols + WORD_BITS - 1) / WORD_BITS;
+    board->nPlanes = nPlanes;
+    board->data = calloc((size_t)nPlanes * (nRows + 2) * board->nWords, sizeof(uint64_t));
+    if (board->data == NULL)
+    {
+        free(board);
+        return NULL;
+    }
+    return board;
+}
+
+void freeBitboard(Bitboard *board)
+{
+    if (board == NULL)
+    {
+        return;
+    }
+    free(board->data);
+    free(board);
+}
+
+/**
+ * Gives board nPlanes planes, if it has fewer. The new planes are empty.
+ *
+ * Returns 0 on success, or -1 (leaving board as it was) if there is no memory.
+ */
+int growBitboard(Bitboard *board, int nPlanes)
+{
+    if (nPlanes <= board->nPlanes)
+    {
+        return 0;
+    }
+    // the planes are one after the other, so the new ones go at the end
+    size_t planeWords = (size_t)(board->nRows + 2) * board->nWords;
+    uint64_t *data = realloc(board->data, sizeof(uint64_t) * nPlanes * planeWords);
+    if (data == NULL)
+    {
+        return -1;
+    }
+    memset(data + board->nPlanes * planeWords, 0, sizeof(uint64_t) * (nPlanes - board->nPlanes) * planeWords);
+    board->data = data;
+    board->nPlanes = nPlanes;
+    return 0;
+}
+
+/**
+ * Sets dst to the unpadded nRows by nCols grid src. src must not contain factions above dst->nPlanes.
+ */
+void cellsToBitboard(Bitboard *dst, const cell_t *src)
+{
+    memset(dst->data, 0, sizeof(uint64_t) * dst->nPlanes * (dst->nRows + 2) * dst->nWords);
+    for (int row = 0; row < dst->nRows; row++)
+    {
+        const cell_t *srcRow = src + (long)row * dst->nCols;
+        for (int col = 0; col < dst->nCols; col++)
+        {
+            if (srcRow[col] != DEAD_FACTION)
+            {
+                bitboardRow(dst, srcRow[col] - 1, row)[col / WORD_BITS] |= 1ULL << (col % WORD_BITS);
+            }
+        }
+    }
+}
+
+/**
+ * Flips the bits of every invader of plan in dst, whose planes must cover every faction of plan. Flipping them into
+ * an empty board sets them, and flipping them again empties it, without touching any other word.
+ */
+void flipInvaders(Bitboard *dst, const InvasionPlan *plan)
+{
+    for (long i = 0; i < plan->nInvaders; i++)
+    {
+        const Invader *invader = &plan->invaders[i];
+        bitboardRow(dst, invader->faction - 1, invader->row)[invader->col / WORD_BITS] ^= 1ULL << (invader->col % WORD_BITS);
+    }
+}
+
+/**
+ * Writes src into the unpadded nRows by nCols grid dst.
+ */
+void bitboardToCells(cell_t *dst, const Bitboard *src)
+{
+    memset(dst, DEAD_FACTION, sizeof(cell_t) * src->nRows * src->nCols);
+    for (int plane = 0; plane < src->nPlanes; plane++)
+    {
+        for (int row = 0; row < src->nRows; row++)
+        {
+            const uint64_t *words = bitboardRow(src, plane, row);
+            cell_t *dstRow = dst + (long)row * src->nCols;
+            for (int col = 0; col < src->nCols; col++)
+            {
+                if (words[col / WORD_BITS] >> (col % WORD_BITS) & 1)
+                {
+                    dstRow[col] = plane + 1;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Bit-parallel full adder: adds a, b and c in every bit into *sum (weight 1) and *carry (weight 2).
+ */
+static inline void fullAdd(uint64_t a, uint64_t b, uint64_t c, uint64_t *sum, uint64_t *carry)
+{
+    uint64_t t = a ^ b;
+    *sum = t ^ c;
+    *carry = (a & b) | (t & c);
+}
+
+/**
+ * Counts, for every bit of word w, how many of its 8 neighbours are set in the rows above, at and below it.
+ * The count (0 to 8) is stored bit-sliced: bit i of the count is in count[i].
+ *
+ * This is a carry-save adder tree over the 8 shifted neighbour words.
+ */
+static inline void countNeighbors(const uint64_t *above, const uint64_t *at, const uint64_t *below, int w, int nWords, uint64_t count[4])
+{
+    const uint64_t *rows[3] = {above, at, below};
+    uint64_t west[3], east[3];
+    for (int i = 0; i < 3; i++)
+    {
+        // the west neighbour of bit b is bit b - 1, so it is shifted up by one; east is the opposite
+        west[i] = rows[i][w] << 1 | (w > 0 ? rows[i][w - 1] >> (WORD_BITS - 1) : 0);
+        east[i] = rows[i][w] >> 1 | (w + 1 < nWords ? rows[i][w + 1] << (WORD_BITS - 1) : 0);
+    }
+
+    uint64_t s1, c1, s2, c2, s3, c3, c4, t, c5;
+    fullAdd(west[0], above[w], east[0], &s1, &c1);
+    fullAdd(west[2], below[w], east[2], &s2, &c2);
+    s3 = west[1] ^ east[1];
+    c3 = west[1] & east[1];
+
+    fullAdd(s1, s2, s3, &count[0], &c4);
+    fullAdd(c1, c2, c3, &t, &c5);
+    uint64_t c6 = t & c4;
+    count[1] = t ^ c4;
+    count[2] = c5 ^ c6;
+    count[3] = c5 & c6;
+}
+
+/**
+ * Returns whether the words w - 1 to w + 1 of the rows above, at and below are all 0.
+ */
+static inline int isQuiet(const uint64_t *above, const uint64_t *at, const uint64_t *below, int w, int nWords)
+{
+    int first = w > 0 ? w - 1 : w;
+    int last = w + 1 < nWords ? w + 1 : w;
+    uint64_t any = 0;
+    for (int i = first; i <= last; i++)
+    {
+        any |= above[i] | at[i] | below[i];
+    }
+    return any == 0;
+}
+
+/**
+ * Writes the OR of every plane of row of board into live.
+ */
+static void liveRow(const Bitboard *board, int row, uint64_t *live)
+{
+    memset(live, 0, sizeof(uint64_t) * board->nWords);
+    for (int plane = 0; plane < board->nPlanes; plane++)
+    {
+        const uint64_t *words = bitboardRow(board, plane, row);
+        for (int w = 0; w < board->nWords; w++)
+        {
+            live[w] |= words[w];
+        }
+    }
+}
+
+/**
+ * Writes the next state of rows [rowStart, rowEnd) of currBoard, with invaders landing, into nextBoard. Returns
+ * the number of those cells that count towards the death toll due to fighting.
+ *
+ * invaders can be NULL if there are no invaders; otherwise it must have the same planes as currBoard. Rows of
+ * nextBoard outside [rowStart, rowEnd) are not touched, so disjoint row ranges can be computed concurrently.
+ *
+ * liveRows is scratch space of at least 3 * nWords words that only this call may use while it runs; it is
+ * passed in so that stepping a board allocates nothing.
+ *
+ * The rules are those of getNextState, 64 cells at a time. For faction f with friendly count F and live
+ * neighbour count L (both bit-sliced), a live f cell fights iff F != L, survives iff it does not fight and
+ * F is 2 or 3, and a dead cell becomes f iff F is 3 and no higher faction also has 3 neighbours.
+ */
+int nextBitboardRows(const Bitboard *currBoard, const Bitboard *invaders, Bitboard *nextBoard, int rowStart, int rowEnd, uint64_t *liveRows)
+{
+    int nWords = currBoard->nWords;
+    int nPlanes = currBoard->nPlanes;
+
+    // the bits past nCols of the last word must stay 0
+    int tailBits = currBoard->nCols % WORD_BITS;
+    uint64_t lastWordMask = tailBits == 0 ? ~0ULL : (1ULL << tailBits) - 1;
+
+    // rolling window of the live (any faction) rows above, at and below the current row
+    uint64_t *liveAbove = liveRows;
+    uint64_t *liveAt = liveRows + nWords;
+    uint64_t *liveBelow = liveRows + 2 * nWords;
+    liveRow(currBoard, rowStart - 1, liveAbove);
+    liveRow(currBoard, rowStart, liveAt);
+
+    int deaths = 0;
+    for (int row = rowStart; row < rowEnd; row++)
+    {
+        liveRow(currBoard, row + 1, liveBelow);
+
+        for (int w = 0; w < nWords; w++)
+        {
+            uint64_t wordMask = w == nWords - 1 ? lastWordMask : ~0ULL;
+
+            // someone just got landed on
+            uint64_t invaded = 0;
+            if (invaders != NULL)
+            {
+                for (int plane = 0; plane < nPlanes; plane++)
+                {
+                    invaded |= bitboardRow(invaders, plane, row)[w];
+                }
+                deaths += __builtin_popcountll(invaded & liveAt[w]);
+            }
+
+            if (isQuiet(liveAbove, liveAt, liveBelow, w, nWords))
+            {
+                // nothing alive around here: only the invaders (if any) end up alive
+                for (int plane = 0; plane < nPlanes; plane++)
+                {
+                    bitboardRow(nextBoard, plane, row)[w] = invaders != NULL ? bitboardRow(invaders, plane, row)[w] : 0;
+                }
+                continue;
+            }
+
+            uint64_t liveCount[4];
+            countNeighbors(liveAbove, liveAt, liveBelow, w, nWords, liveCount);
+
+            // higher factions win births, so go from the top and remember who was already born
+            uint64_t bornSoFar = 0;
+            for (int plane = nPlanes - 1; plane >= 0; plane--)
+            {
+                const uint64_t *above = bitboardRow(currBoard, plane, row - 1);
+                const uint64_t *at = bitboardRow(currBoard, plane, row);
+                const uint64_t *below = bitboardRow(currBoard, plane, row + 1);
+
+                uint64_t next = 0;
+                if (!isQuiet(above, at, below, w, nWords))
+                {
+                    uint64_t friendlyCount[4];
+                    countNeighbors(above, at, below, w, nWords, friendlyCount);
+
+                    uint64_t hostile = (friendlyCount[0] ^ liveCount[0]) | (friendlyCount[1] ^ liveCount[1]) |
+                                       (friendlyCount[2] ^ liveCount[2]) | (friendlyCount[3] ^ liveCount[3]);
+                    uint64_t twoOrThree = friendlyCount[1] & ~friendlyCount[2] & ~friendlyCount[3];
+                    uint64_t three = twoOrThree & friendlyCount[0];
+
+                    uint64_t fight = at[w] & hostile;
+                    uint64_t survives = at[w] & ~hostile & twoOrThree;
+                    uint64_t born = ~liveAt[w] & three & ~bornSoFar & wordMask;
+                    bornSoFar |= born;
+
+                    deaths += __builtin_popcountll(fight & ~invaded);
+                    next = survives | born;
+                }
+
+                if (invaders != NULL)
+                {
+                    next = (next & ~invaded) | bitboardRow(invaders, plane, row)[w];
+                }
+                bitboardRow(nextBoard, plane, row)[w] = next;
+            }
+        }
+
+        // slide the window down by one row
+        uint64_t *oldAbove = liveAbove;
+        liveAbove = liveAt;
+        liveAt = liveBelow;
+        liveBelow = oldAbove;
+    }
+
+    return deaths;
+}
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+/**
+ * Prints and/or exports board as the given generation, depending on settings.h.
+ */
+static void outputBitboard(const Bitboard *board, int generation)
+{
+    cell_t *cells = malloc(sizeof(cell_t) * board->nRows * board->nCols);
+    if (cells == NULL)
+    {
+        fprintf(stderr, "Error: out of memory!\n");
+        return;
+    }
+    bitboardToCells(cells, board);
+    outputWorld(cells, board->nRows, board->nCols, generation);
+    free(cells);
+}
+#endif
+
+/**
+ * Returns the largest faction in the unpadded nRows by nCols grid world.
+ */
+static int maxFactionIn(const cell_t *world, int nRows, int nCols)
+{
+    int maxFaction = DEAD_FACTION;
+    for (long i = 0; i < (long)nRows * nCols; i++)
+    {
+        if (world[i] > maxFaction)
+        {
+            maxFaction = world[i];
+        }
+    }
+    return maxFaction;
+}
+
+/**
+ * The simulation logic of goi, on bitboards. Takes the same arguments as goi (without nThreads: this engine
+ * runs on the calling thread) and returns the same death toll.
+ */
+int bitboardGoi(int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions)
+{
+    // only factions that have appeared need a plane; an invasion that brings a new one adds its plane
+    int nPlanes = maxFactionIn(startWorld, nRows, nCols);
+    if (nPlanes == 0)
+    {
+        // nothing ever lives, but keep the board non-empty
+        nPlanes = 1;
+    }
+
+    // death toll due to fighting
+    int deathToll = 0;
+
+    // the three boards are reused for every generation: world and wholeNewWorld are swapped, and inv only holds
+    // the invaders of an invasion for the generation it lands in
+    Bitboard *world = allocBitboard(nRows, nCols, nPlanes);
+    Bitboard *wholeNewWorld = allocBitboard(nRows, nCols, nPlanes);
+    Bitboard *inv = invasions->nInvasions > 0 ? allocBitboard(nRows, nCols, nPlanes) : NULL;
+    uint64_t *liveRows = world != NULL ? malloc(sizeof(uint64_t) * 3 * world->nWords) : NULL;
+    if (world == NULL || wholeNewWorld == NULL || (invasions->nInvasions > 0 && inv == NULL) || liveRows == NULL)
+    {
+        freeBitboard(world);
+        freeBitboard(wholeNewWorld);
+        freeBitboard(inv);
+        free(liveRows);
+        return -1;
+    }
+    cellsToBitboard(world, startWorld);
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+    outputBitboard(world, 0);
+#endif
+
+    for (int i = 1; i <= nGenerations; i++)
+    {
+        // is there an invasion this generation?
+        const InvasionPlan *plan = NULL;
+        if (nextInvasionTime(invasions) == i)
+        {
+            plan = takeInvasionPlan(invasions);
+        }
+
+        if (plan != NULL)
+        {
+            // the first invasion of a faction brings its plane
+            int planFaction = maxInvaderFaction(plan);
+            if (growBitboard(world, planFaction) != 0 || growBitboard(wholeNewWorld, planFaction) != 0 || growBitboard(inv, planFaction) != 0)
+            {
+                deathToll = -1;
+                break;
+            }
+
+            flipInvaders(inv, plan);
+            deathToll += nextBitboardRows(world, inv, wholeNewWorld, 0, nRows, liveRows);
+            flipInvaders(inv, plan);
+        }
+        else
+        {
+            deathToll += nextBitboardRows(world, NULL, wholeNewWorld, 0, nRows, liveRows);
+        }
+
+        // swap worlds
+        Bitboard *oldWorld = world;
+        world = wholeNewWorld;
+        wholeNewWorld = oldWorld;
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+        outputBitboard(world, i);
+#endif
+    }
+
+    freeBitboard(world);
+    freeBitboard(wholeNewWorld);
+    freeBitboard(inv);
+    free(liveRows);
+    return deathToll;
+}
@@ -7,325 +7,253 @@
 #include "util.h"
 #include "exporter.h"
 #include "settings.h"
+#include "grid.h"
+#include "kernel.h"
+#include "tiles.h"
+#include "cycle.h"
+#include "bitboard.h"
+#include "hashlife.h"
+#include "engine.h"
+#include "sparse.h"
+#include "placement.h"
+#include "wait.h"
 #include <pthread.h>
 #include "goi.h"
 
-// including the "dead faction": 0
-#define MAX_FACTIONS 10
-
-// this macro is here to make the code slightly more readable, not because it can be safely changed to
-// any integer value; changing this to a non-zero value may break the code
-#define DEAD_FACTION 0
-
-// struct to contain the args for tasks
+// state shared by the main thread and every worker for a whole goi() call
+typedef struct SharedState {
+    // every thread waits here once before and once after each generation, as set by GOI_WAIT_POLICY
+    Barrier barrier;
+    // only the main thread writes these, and only while every worker is waiting at the barrier
+    const PaddedWorld *world;
+    const InvasionPlan *inv;
+    PaddedWorld *wholeNewWorld;
+    TileMap *tiles;
+    bool done;
+    // the index into tiles->active of the next tile to be claimed this generation
+    int nextTile;
+    // the deaths due to fighting of this generation, which every thread adds its own to
+    int deaths;
+} SharedState;
+
+// struct to contain the args for each thread
 typedef struct TaskArgs {
-    const int *world;
-    const int *inv;
-    int *wholeNewWorld;
-    int nRows;
-    int nCols;
-    int startRow;
-    int endRow;
-    int retVal;
+    SharedState *shared;
+    // the number of the thread, which picks its CPU if threads are pinned
+    int index;
 } TaskArgs;
 
 /**
-* Specifies the number(s) of live neighbors of the same faction required for a dead cell to become alive.
-*/
-bool isBirthable(int n)
-{
-    return n == 3;
-}
-
-/**
- * Specifies the number(s) of live neighbors of the same faction required for a live cell to remain alive.
+ * Claims and computes active tiles of the next generation until there are none left, and returns the deaths due
+ * to fighting among them.
+ *
+ * How much work a tile takes varies, so rather than splitting them up front, every thread claims them one at a time.
  */
-bool isSurvivable(int n)
+static int simulateTiles(SharedState *shared)
 {
-    return n == 2 || n == 3;
+    int deaths = 0;
+    int t;
+    while ((t = __atomic_fetch_add(&shared->nextTile, 1, __ATOMIC_RELAXED)) < shared->tiles->nActive) {
+        deaths += nextTileState(shared->tiles, shared->tiles->active[t], shared->world, shared->inv, shared->wholeNewWorld);
+    }
+    return deaths;
 }
 
 /**
- * Specifies the number of live neighbors of a different faction required for a live cell to die due to fighting.
+ * The loop run by every worker for the whole simulation: wait for the main thread to set up a generation, help
+ * compute its tiles, then wait for everyone else to finish theirs.
+ *
+ * The deaths of every generation are added to shared->deaths once, so that the main thread has the whole death
+ * toll after each generation (skipping cycles needs it).
  */
-bool willFight(int n) {
-    return n > 0;
-}
-
 void* threadWork(void* args) {
     TaskArgs *tArgs = (TaskArgs*) args;
-    int taskDeathToll = 0;
-    for (int row = tArgs->startRow; row < tArgs->endRow && row < tArgs->nRows; row++) {
-        for (int col = 0; col < tArgs->nCols; col++) {
-            bool diedDueToFighting;
-            int nextState = getNextState(tArgs->world, tArgs->inv, tArgs->nRows, tArgs->nCols, row, col, &diedDueToFighting);
-            setValueAt(tArgs->wholeNewWorld, tArgs->nRows, tArgs->nCols, row, col, nextState);
-            if (diedDueToFighting) {
-                taskDeathToll++;
-            }
+    SharedState *shared = tArgs->shared;
+    pinThread(tArgs->index);
+    while (true) {
+        waitBarrier(&shared->barrier);
+        if (shared->done) {
+            break;
         }
+        __atomic_fetch_add(&shared->deaths, simulateTiles(shared), __ATOMIC_RELAXED);
+        waitBarrier(&shared->barrier);
     }
-    tArgs->retVal = taskDeathToll;
-    pthread_exit(0);
+    return NULL;
 }
 
 /**
- * Computes and returns the next state of the cell specified by row and col based on currWorld and invaders. Sets *diedDueToFighting to
- * true if this cell should count towards the death toll due to fighting.
+ * The main simulation logic.
  * 
- * invaders can be NULL if there are no invaders.
+ * goi does not own startWorld or invasions and should not modify or attempt to free them. It takes the plan of each
+ * invasion from invasions as the invasion lands (see stream.h).
+ * nThreads is the number of threads to simulate with. It is ignored by the sequential implementation.
+ *
+ * Internally, every world is kept as a PaddedWorld: startWorld is copied in once and invasion plans are read in place.
+ *
+ * The main thread computes tiles alongside nThreads - 1 workers, which are created once for the whole
+ * simulation. Between generations, only the main thread runs: it swaps the two worlds and points at any invasion.
  */
-int getNextState(const int *currWorld, const int *invaders, int nRows, int nCols, int row, int col, bool *diedDueToFighting)
+int goi(int nThreads, int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions)
 {
-    // we'll explicitly set if it was death due to fighting
-    *diedDueToFighting = false;
-
-    // faction of this cell
-    int cellFaction = getValueAt(currWorld, nRows, nCols, row, col);
-
-    // did someone just get landed on?
-    if (invaders != NULL && getValueAt(invaders, nRows, nCols, row, col) != DEAD_FACTION)
+    // the bitboard engine runs the whole simulation on its own, on this thread
+    if (getEngineKind() == ENGINE_BITBOARD)
     {
-        *diedDueToFighting = cellFaction != DEAD_FACTION;
-        return getValueAt(invaders, nRows, nCols, row, col);
+        return bitboardGoi(nGenerations, startWorld, nRows, nCols, invasions);
+    }
+    // and so does the hashlife engine
+    if (getEngineKind() == ENGINE_HASHLIFE)
+    {
+        return hashlifeGoi(nGenerations, startWorld, nRows, nCols, invasions);
     }
 
-    // tracks count of each faction adjacent to this cell
-    int neighborCounts[MAX_FACTIONS];
-    memset(neighborCounts, 0, MAX_FACTIONS * sizeof(int));
+    // pick the fastest row kernel for this CPU
+    initKernel();
 
-    // count neighbors (and self)
-    for (int dy = -1; dy <= 1; dy++)
+    if (nThreads < 1)
     {
-        for (int dx = -1; dx <= 1; dx++)
-        {
-            int faction = getValueAt(currWorld, nRows, nCols, row + dy, col + dx);
-            if (faction >= DEAD_FACTION)
-            {
-                neighborCounts[faction]++;
-            }
-        }
+        nThreads = 1;
     }
 
-    // we counted this cell as its "neighbor"; adjust for this
-    neighborCounts[cellFaction]--;
+    // death toll due to fighting
+    int deathToll = 0;
 
-    if (cellFaction == DEAD_FACTION)
+    // init the world!
+    // we make a copy because we do not own startWorld; after this, simulating allocates nothing
+    // each band of rows of the worlds is first touched on the CPU of the thread with the same number
+    initPlacement(nThreads);
+    WorldBuffers worlds;
+    if (allocWorldBuffers(&worlds, nRows, nCols) != 0)
     {
-        // this is a dead cell; we need to see if a birth is possible:
-        // need exactly 3 of a single faction; we don't care about other factions
-
-        // by default, no birth
-        int newFaction = DEAD_FACTION;
+        return -1;
+    }
+    placeWorldBuffers(&worlds, startWorld, nThreads);
 
-        // start at 1 because we ignore dead neighbors
-        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
-        {
-            int count = neighborCounts[faction];
-            if (isBirthable(count))
-            {
-                newFaction = faction;
-            }
-        }
+#if REPORT_PLACEMENT
+    reportPlacement();
+#endif
 
-        return newFaction;
-    }
-    else
+    // only the tiles that can change are recomputed
+    TileMap *tiles = allocTileMap(worlds.curr);
+    // and once the world repeats itself, whole periods are skipped
+    CycleDetector *cycles = allocCycleDetector(nRows, nCols);
+    if (tiles == NULL || cycles == NULL)
     {
-        /** 
-         * this is a live cell; we follow the usual rules:
-         * Death (fighting): > 0 hostile neighbor
-         * Death (underpopulation): < 2 friendly neighbors and 0 hostile neighbors
-         * Death (overpopulation): > 3 friendly neighbors and 0 hostile neighbors
-         * Survival: 2 or 3 friendly neighbors and 0 hostile neighbors
-         */
-
-        int hostileCount = 0;
-        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
-        {
-            if (faction == cellFaction)
-            {
-                continue;
-            }
-            hostileCount += neighborCounts[faction];
-        }
+        freeTileMap(tiles);
+        freeCycleDetector(cycles);
+        freeWorldBuffers(&worlds);
+        return -1;
+    }
 
-        if (willFight(hostileCount))
-        {
-            *diedDueToFighting = true;
-            return DEAD_FACTION;
-        }
+    // with the sparse engine, a world with few live cells is computed one live cell at a time, on this thread
+    SparseEngine *sparse = NULL;
+    if (getEngineKind() == ENGINE_SPARSE && (sparse = allocSparseEngine(nRows, nCols)) == NULL)
+    {
+        freeCycleDetector(cycles);
+        freeTileMap(tiles);
+        freeWorldBuffers(&worlds);
+        return -1;
+    }
 
-        int friendlyCount = neighborCounts[cellFaction];
-        if (!isSurvivable(friendlyCount))
-        {
-            return DEAD_FACTION;
-        }
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+    outputPaddedWorld(worlds.curr, 0);
+#endif
 
-        return cellFaction;
+    SharedState shared;
+    shared.done = false;
+    shared.tiles = tiles;
+    if (initBarrier(&shared.barrier, nThreads, getWaitPolicy()) != 0)
+    {
+        printf("Failed to initialise barrier\n");
+        freeSparseEngine(sparse);
+        freeCycleDetector(cycles);
+        freeTileMap(tiles);
+        freeWorldBuffers(&worlds);
+        return -1;
     }
-}
 
-/**
- * The main simulation logic.
- * 
- * goi does not own startWorld, invasionTimes or invasionPlans and should not modify or attempt to free them.
- * nThreads is the number of threads to simulate with. It is ignored by the sequential implementation.
- */
-int goi(int nThreads, int nGenerations, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans)
-{
-    // death toll due to fighting
-    int deathToll = 0;
-    
-    // Array to store threads
+    // Array to store threads; index 0 is the main thread, which is not created
     pthread_t threads[nThreads];
     
     // Args for each thread
-    TaskArgs *tArgs[nThreads];
+    TaskArgs tArgs[nThreads];
 
     /*** Initialise the thread args ***/
-    // Number of rows each thread works on
-    int rowsPerThread = nRows / nThreads;
-
-    // When nRows % nThreads != 0, we want to
-    // split the remainder rows equally amoung
-    // each row (i.e. every thread should take on at
-    // most 1 more row than rowsPerThread)
-    int leftoverRows = nRows % nThreads;
-
-    int startRow = 0, endRow;
     for (int threadIdx = 0; threadIdx < nThreads; threadIdx++)
     {
-	  tArgs[threadIdx] = (TaskArgs*) malloc(sizeof(TaskArgs));
-	  tArgs[threadIdx]->startRow = startRow;
-	  endRow = startRow + rowsPerThread;
-	  if (leftoverRows > 0)
-	  {
-		  leftoverRows--;
-		  endRow++;
-	  }
-	  tArgs[threadIdx]->endRow = endRow;
-	  tArgs[threadIdx]->nRows = nRows;
-	  tArgs[threadIdx]->nCols = nCols;
-	  tArgs[threadIdx]->retVal = 0;
-	  startRow = endRow;
+	  tArgs[threadIdx].shared = &shared;
+	  tArgs[threadIdx].index = threadIdx;
     }
 
-
-    // init the world!
-    // we make a copy because we do not own startWorld (and will perform free() on world)
-    int *world = malloc(sizeof(int) * nRows * nCols);
-    if (world == NULL)
-    {
-        return -1;
-    }
-    /*for (int row = 0; row < nRows; row++)
-    {
-        for (int col = 0; col < nCols; col++)
-        {
-            setValueAt(world, nRows, nCols, row, col, getValueAt(startWorld, nRows, nCols, row, col));
+    for (int threadIdx = 1; threadIdx < nThreads; threadIdx++) {
+        int rc = pthread_create(&threads[threadIdx], NULL, threadWork, &tArgs[threadIdx]);
+        if (rc) {
+            printf("Error creating thread\n");
+            exit(1);
         }
-    }*/
-    memcpy(world, startWorld, nRows * nCols * sizeof(int));
-
-#if PRINT_GENERATIONS
-    printf("\n=== WORLD 0 ===\n");
-    printWorld(world, nRows, nCols);
-#endif
-
-#if EXPORT_GENERATIONS
-    exportWorld(world, nRows, nCols);
-#endif
+    }
 
     // Begin simulating
-    int invasionIndex = 0;
     for (int i = 1; i <= nGenerations; i++)
     {
         // is there an invasion this generation?
-        int *inv = NULL;
-        if (invasionIndex < nInvasions && i == invasionTimes[invasionIndex])
+        // its plan is only ever read, and stays valid until the next invasion is taken
+        shared.inv = NULL;
+        if (nextInvasionTime(invasions) == i)
         {
-            // we make a copy because we do not own invasionPlans
-            inv = malloc(sizeof(int) * nRows * nCols);
-            if (inv == NULL)
-            {
-                free(world);
-                return -1;
-            }
-            /*for (int row = 0; row < nRows; row++)
-            {
-                for (int col = 0; col < nCols; col++)
-                {
-                    setValueAt(inv, nRows, nCols, row, col, getValueAt(invasionPlans[invasionIndex], nRows, nCols, row, col));
-                }
-            }*/
-            memcpy(inv, invasionPlans[invasionIndex], nRows * nCols * sizeof(int));
-            invasionIndex++;
+            shared.inv = takeInvasionPlan(invasions);
         }
 
-        // create the next world state
-        int *wholeNewWorld = malloc(sizeof(int) * nRows * nCols);
-        if (wholeNewWorld == NULL)
+        // a sparse world is computed by the sparse engine alone, which goes back to the dense engine once it fills up
+        bool isSparse = sparse != NULL && nextSparseState(sparse, &worlds, shared.inv, tiles, &deathToll);
+        if (!isSparse)
         {
-            if (inv != NULL)
-            {
-                free(inv);
-            }
-            free(world);
-            return -1;
-        }
-
-        for (int threadIdx = 0; threadIdx < nThreads; threadIdx++) {
-            // Set args for each thread
-            tArgs[threadIdx]->world = world;
-            tArgs[threadIdx]->wholeNewWorld = wholeNewWorld;
-            tArgs[threadIdx]->inv = inv;
-
-            int rc = pthread_create(&threads[threadIdx], NULL, threadWork, tArgs[threadIdx]);
-            if (rc) {
-                printf("Error creating thread\n");
-                if (inv != NULL) 
-                {
-                    free(inv);
-                }
-                free(world);
-                free(wholeNewWorld);
-                exit(1);
-            } 
-        }
+            shared.world = worlds.curr;
+            shared.wholeNewWorld = worlds.next;
+            shared.nextTile = 0;
+            shared.deaths = 0;
+            planTiles(tiles, shared.inv);
+
+#if REPORT_ACTIVE_TILES
+            reportActiveTiles(tiles, i);
+#endif
 
-        // Join threads
-        for (int threadIdx = 0; threadIdx < nThreads; threadIdx++) {
-            pthread_join(threads[threadIdx], NULL);
-            deathToll += tArgs[threadIdx]->retVal;
-	        tArgs[threadIdx]->retVal = 0;
+            // release the workers, help with the tiles, then wait for the workers to finish theirs
+            waitBarrier(&shared.barrier);
+            __atomic_fetch_add(&shared.deaths, simulateTiles(&shared), __ATOMIC_RELAXED);
+            waitBarrier(&shared.barrier);
+            deathToll += shared.deaths;
         }
 
-
-        if (inv != NULL)
+        // swap worlds
+        swapWorldBuffers(&worlds);
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+        outputPaddedWorld(worlds.curr, i);
+#else
+        // a cycle can only be followed up to the next invasion; every generation is output, so none can be skipped then
+        int target = nGenerations;
+        int nextTime = nextInvasionTime(invasions);
+        if (nextTime > i && nextTime <= nGenerations)
         {
-            free(inv);
+            target = nextTime - 1;
         }
-
-        // swap worlds
-        free(world);
-        world = wholeNewWorld;
-
-#if PRINT_GENERATIONS
-        printf("\n=== WORLD %d ===\n", i);
-        printWorld(world, nRows, nCols);
-#endif
-
-#if EXPORT_GENERATIONS
-        exportWorld(world, nRows, nCols);
+        i = skipCycles(cycles, worlds.curr, isSparse ? sparse->hash : worldHash(tiles), i, shared.inv != NULL, target, &deathToll);
 #endif
     }
 
-    for (int threadIdx = 0; threadIdx < nThreads; threadIdx++)
-    {
-	    free(tArgs[threadIdx]);
-	    tArgs[threadIdx] = NULL;
+    // release the workers one last time so that they see done and exit
+    shared.done = true;
+    waitBarrier(&shared.barrier);
+
+    // Join threads
+    for (int threadIdx = 1; threadIdx < nThreads; threadIdx++) {
+        pthread_join(threads[threadIdx], NULL);
     }
-    free(world);
+    destroyBarrier(&shared.barrier);
+
+    freeSparseEngine(sparse);
+    freeCycleDetector(cycles);
+    freeTileMap(tiles);
+    freeWorldBuffers(&worlds);
     return deathToll;
 }
@@ -1,7 +1,9 @@
 #ifndef GOI_H
 #define GOI_H
 
-int goi(int nThreads, int nGenerations, const int *startWorld, int nRows, int nCols, int nInvasions, const int *invasionTimes, int **invasionPlans);
-int getNextState(const int *currWorld, const int *invaders, int nRows, int nCols, int row, int col, bool *diedDueToFighting);
+#include "grid.h"
+#include "stream.h"
+
+int goi(int nThreads, int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions);
 
 #endif
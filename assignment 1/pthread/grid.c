@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include "grid.h"
+#include "util.h"
+#include "placement.h"
+
+// the number of successful allocPaddedWorld calls so far
+static long worldAllocations = 0;
+
+/**
+ * Allocates a zeroed (i.e. entirely DEAD_FACTION) padded world of nRows by nCols.
+ *
+ * Its cells come from allocPlacedMemory and are not touched here, so each page lands on the NUMA node of the thread
+ * that first writes it (see placeWorldRows).
+ *
+ * NULL is returned if there is no memory.
+ */
+PaddedWorld *allocPaddedWorld(int nRows, int nCols)
+{
+    PaddedWorld *world = malloc(sizeof(PaddedWorld));
+    if (world == NULL)
+    {
+        return NULL;
+    }
+
+    // round the stride up to a whole number of cache lines
+    int cellsPerLine = CACHE_LINE_SIZE / sizeof(cell_t);
+    int stride = (nCols + 2 + cellsPerLine - 1) / cellsPerLine * cellsPerLine;
+
+    // one cache line of slack past the halo lets vector kernels read a whole vector starting at any cell
+    size_t size = sizeof(cell_t) * (size_t)stride * (nRows + 2) + CACHE_LINE_SIZE;
+
+    world->data = allocPlacedMemory(size, false);
+    if (world->data == NULL)
+    {
+        free(world);
+        return NULL;
+    }
+
+    world->nRows = nRows;
+    world->nCols = nCols;
+    world->stride = stride;
+    world->cells = world->data + stride + 1;
+    __atomic_fetch_add(&worldAllocations, 1, __ATOMIC_RELAXED);
+    return world;
+}
+
+void freePaddedWorld(PaddedWorld *world)
+{
+    if (world == NULL)
+    {
+        return;
+    }
+    freePlacedMemory(world->data);
+    free(world);
+}
+
+/**
+ * Returns the number of worlds allocPaddedWorld has allocated so far in this process. Comparing it before and
+ * after a stretch of generations shows whether they allocated anything.
+ */
+long getWorldAllocationCount(void)
+{
+    return __atomic_load_n(&worldAllocations, __ATOMIC_RELAXED);
+}
+
+/**
+ * Copies the unpadded nRows by nCols grid src into dst. The halo of dst is left untouched.
+ */
+void padWorld(PaddedWorld *dst, const cell_t *src)
+{
+    for (int row = 0; row < dst->nRows; row++)
+    {
+        memcpy(paddedRow(dst, row), src + (long)row * dst->nCols, sizeof(cell_t) * dst->nCols);
+    }
+}
+
+/**
+ * Copies the cells of src, without the halo, into the unpadded nRows by nCols grid dst.
+ */
+void unpadWorld(cell_t *dst, const PaddedWorld *src)
+{
+    for (int row = 0; row < src->nRows; row++)
+    {
+        memcpy(dst + (long)row * src->nCols, paddedRow(src, row), sizeof(cell_t) * src->nCols);
+    }
+}
+
+/**
+ * Copies the cells of src into dst. Both must have been allocated with the same size.
+ */
+void copyPaddedWorld(PaddedWorld *dst, const PaddedWorld *src)
+{
+    for (int row = 0; row < src->nRows; row++)
+    {
+        memcpy(paddedRow(dst, row), paddedRow(src, row), sizeof(cell_t) * src->nCols);
+    }
+}
+
+/**
+ * Returns true if the cells of a and b, which must be the same size, are all the same.
+ */
+bool isSamePaddedWorld(const PaddedWorld *a, const PaddedWorld *b)
+{
+    for (int row = 0; row < a->nRows; row++)
+    {
+        if (memcmp(paddedRow(a, row), paddedRow(b, row), sizeof(cell_t) * a->nCols) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Prints and/or exports world as the given generation, depending on settings.h.
+ *
+ * The halo is stripped first so the output is the same as it would be for an unpadded world.
+ */
+void outputPaddedWorld(const PaddedWorld *world, int generation)
+{
+    cell_t *unpadded = malloc(sizeof(cell_t) * world->nRows * world->nCols);
+    if (unpadded == NULL)
+    {
+        fprintf(stderr, "Error: out of memory!\n");
+        return;
+    }
+    unpadWorld(unpadded, world);
+    outputWorld(unpadded, world->nRows, world->nCols, generation);
+    free(unpadded);
+}
+
+/**
+ * Allocates both worlds of buffers, without touching them; placeWorldRows then fills them.
+ *
+ * Returns 0 on success, or -1 (with nothing left allocated) if there is no memory.
+ */
+int allocWorldBuffers(WorldBuffers *buffers, int nRows, int nCols)
+{
+    buffers->curr = allocPaddedWorld(nRows, nCols);
+    buffers->next = allocPaddedWorld(nRows, nCols);
+    if (buffers->curr == NULL || buffers->next == NULL)
+    {
+        freeWorldBuffers(buffers);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Copies band of nBands equal bands of rows of the unpadded grid startWorld into buffers->curr, and writes the same
+ * rows of buffers->next, halo included, so that the calling thread is the first to touch them. Different bands can
+ * be placed concurrently.
+ */
+void placeWorldRows(WorldBuffers *buffers, const cell_t *startWorld, int band, int nBands)
+{
+    PaddedWorld *curr = buffers->curr;
+    // the bands cover the halo rows too, from -1 to nRows
+    int nPaddedRows = curr->nRows + 2;
+    int rowStart = (int)((long)nPaddedRows * band / nBands) - 1;
+    int rowEnd = (int)((long)nPaddedRows * (band + 1) / nBands) - 1;
+    for (int row = rowStart; row < rowEnd; row++)
+    {
+        memset(paddedRow(curr, row) - 1, DEAD_FACTION, sizeof(cell_t) * curr->stride);
+        memset(paddedRow(buffers->next, row) - 1, DEAD_FACTION, sizeof(cell_t) * curr->stride);
+        if (row >= 0 && row < curr->nRows)
+        {
+            memcpy(paddedRow(curr, row), startWorld + (long)row * curr->nCols, sizeof(cell_t) * curr->nCols);
+        }
+    }
+}
+
+/**
+ * Allocates both worlds of buffers and copies the unpadded nRows by nCols grid startWorld into curr, all on the
+ * calling thread.
+ *
+ * Returns 0 on success, or -1 (with nothing left allocated) if there is no memory.
+ */
+int initWorldBuffers(WorldBuffers *buffers, const cell_t *startWorld, int nRows, int nCols)
+{
+    if (allocWorldBuffers(buffers, nRows, nCols) != 0)
+    {
+        return -1;
+    }
+    placeWorldRows(buffers, startWorld, 0, 1);
+    return 0;
+}
+
+void freeWorldBuffers(WorldBuffers *buffers)
+{
+    freePaddedWorld(buffers->curr);
+    freePaddedWorld(buffers->next);
+    buffers->curr = NULL;
+    buffers->next = NULL;
+}
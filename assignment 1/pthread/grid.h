@@ -0,0 +1,103 @@
+#ifndef GRID_H
+#define GRID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "settings.h"
+
+// including the "dead faction": 0
+#define MAX_FACTIONS 10
+
+// this macro is here to make the code slightly more readable, not because it can be safely changed to
+// any integer value; changing this to a non-zero value may break the code
+#define DEAD_FACTION 0
+
+// every row of a PaddedWorld starts on one of these
+#define CACHE_LINE_SIZE 64
+
+/**
+ * The type of a single cell. With PACKED_CELLS, a faction (0 to MAX_FACTIONS - 1) fits in a byte.
+ */
+#if PACKED_CELLS
+typedef uint8_t cell_t;
+#else
+typedef int cell_t;
+#endif
+
+/**
+ * A world stored with a one-cell ring of DEAD_FACTION around it (the halo).
+ *
+ * Every in-bounds cell therefore has all 8 neighbours in memory, so the stencil can read them without
+ * bounds checks. This is equivalent to the unpadded representation because dead neighbours never count
+ * towards births, survival or fighting.
+ *
+ * cells points at (0, 0); (row, col) lives at cells[row * stride + col] for -1 <= row <= nRows and
+ * -1 <= col <= nCols. stride is at least nCols + 2 and is rounded up so that rows start on a cache line.
+ */
+typedef struct PaddedWorld {
+    cell_t *data;
+    cell_t *cells;
+    int nRows;
+    int nCols;
+    int stride;
+} PaddedWorld;
+
+/**
+ * The two worlds of a simulation: curr holds the current generation and the next one is written into next.
+ *
+ * Both are allocated once by initWorldBuffers and swapWorldBuffers trades them after every generation, so
+ * stepping through generations allocates nothing.
+ */
+typedef struct WorldBuffers {
+    PaddedWorld *curr;
+    PaddedWorld *next;
+} WorldBuffers;
+
+PaddedWorld *allocPaddedWorld(int nRows, int nCols);
+void freePaddedWorld(PaddedWorld *world);
+long getWorldAllocationCount(void);
+void padWorld(PaddedWorld *dst, const cell_t *src);
+void unpadWorld(cell_t *dst, const PaddedWorld *src);
+void copyPaddedWorld(PaddedWorld *dst, const PaddedWorld *src);
+bool isSamePaddedWorld(const PaddedWorld *a, const PaddedWorld *b);
+void outputPaddedWorld(const PaddedWorld *world, int generation);
+int allocWorldBuffers(WorldBuffers *buffers, int nRows, int nCols);
+void placeWorldRows(WorldBuffers *buffers, const cell_t *startWorld, int band, int nBands);
+int initWorldBuffers(WorldBuffers *buffers, const cell_t *startWorld, int nRows, int nCols);
+void freeWorldBuffers(WorldBuffers *buffers);
+
+/**
+ * Returns a pointer to (row, 0) of world. row may be -1 or nRows to address the halo.
+ */
+static inline cell_t *paddedRow(const PaddedWorld *world, int row)
+{
+    return world->cells + (long)row * world->stride;
+}
+
+/**
+ * Returns the value at row and col of world without bounds checking.
+ */
+static inline int getPaddedValueAt(const PaddedWorld *world, int row, int col)
+{
+    return paddedRow(world, row)[col];
+}
+
+/**
+ * Sets the value at row and col of world without bounds checking.
+ */
+static inline void setPaddedValueAt(PaddedWorld *world, int row, int col, int val)
+{
+    paddedRow(world, row)[col] = val;
+}
+
+/**
+ * Makes the world just computed into next the current one; the old current world is overwritten next.
+ */
+static inline void swapWorldBuffers(WorldBuffers *buffers)
+{
+    PaddedWorld *tmp = buffers->curr;
+    buffers->curr = buffers->next;
+    buffers->next = tmp;
+}
+
+#endif
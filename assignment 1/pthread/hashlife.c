@@ -0,0 +1,646 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "hashlife.h"
+#include "kernel.h"
+#include "settings.h"
+
+// the state of every cell outside the world: it never changes and counts as a dead neighbour, so the edge of the
+// world behaves exactly like the halo of a PaddedWorld
+#define WALL MAX_FACTIONS
+
+// enough levels for any int-sized world advanced by any int number of generations
+#define MAX_LEVEL 64
+
+// the largest power of 2 generations advanced at once; 2^30 is the largest that fits in an int
+#define MAX_STEP 30
+
+// once this many nodes exist, they are all dropped (with their successors) and the tree is rebuilt from the world
+#define MAX_NODES (1L << 21)
+
+#define NODES_PER_BLOCK 65536
+#define MIN_BUCKETS 65536
+
+/**
+ * A square of 2^level by 2^level cells. A level 0 node is a single cell; any other node is made of 4 quadrants one
+ * level down.
+ */
+typedef struct Node {
+    // the nw, ne, sw and se quadrants; all NULL for a single cell
+    struct Node *quad[4];
+    // the next node in the same bucket of the store
+    struct Node *next;
+    // the centre half of this node, 2^resultStep generations later (NULL if not computed yet), and how many cells
+    // of each of its quadrants died due to fighting over those generations
+    struct Node *result;
+    int resultDeaths[4];
+    int resultStep;
+    int level;
+    // the faction of a single cell (or WALL)
+    int state;
+} Node;
+
+typedef struct NodeBlock {
+    struct NodeBlock *prev;
+    int nUsed;
+    Node nodes[NODES_PER_BLOCK];
+} NodeBlock;
+
+/**
+ * Owns every node and makes sure no two nodes have the same quadrants.
+ */
+typedef struct NodeStore {
+    Node **buckets;
+    size_t nBuckets;
+    long nNodes;
+    NodeBlock *blocks;
+    // the single cells, one per state
+    Node cells[MAX_FACTIONS + 1];
+    // wall[level] is the node of only WALL cells at that level, once built
+    Node *wall[MAX_LEVEL];
+} NodeStore;
+
+/**
+ * The world being simulated: its nRows by nCols cells start at row and column offset of root, and every other cell
+ * of root is a WALL. The world always lies within the centre half of root, which is what advancing root yields.
+ */
+typedef struct Hashlife {
+    NodeStore store;
+    Node *root;
+    long offset;
+    int nRows;
+    int nCols;
+} Hashlife;
+
+static uint64_t hashQuads(Node *const quad[4])
+{
+    uint64_t hash = 0;
+    for (int q = 0; q < 4; q++)
+    {
+        hash = (hash ^ (uintptr_t)quad[q]) * 0x9e3779b97f4a7c15ULL;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+/**
+ * Doubles the buckets of store once it holds more nodes than buckets. If there is no memory for that, the chains
+ * just get longer.
+ */
+static void growBuckets(NodeStore *store)
+{
+    size_t nBuckets = store->nBuckets * 2;
+    Node **buckets = calloc(nBuckets, sizeof(Node *));
+    if (buckets == NULL)
+    {
+        return;
+    }
+    for (size_t b = 0; b < store->nBuckets; b++)
+    {
+        Node *node = store->buckets[b];
+        while (node != NULL)
+        {
+            Node *next = node->next;
+            size_t bucket = hashQuads(node->quad) & (nBuckets - 1);
+            node->next = buckets[bucket];
+            buckets[bucket] = node;
+            node = next;
+        }
+    }
+    free(store->buckets);
+    store->buckets = buckets;
+    store->nBuckets = nBuckets;
+}
+
+/**
+ * Returns the node made of the quadrants nw, ne, sw and se, creating it if there is none yet.
+ *
+ * NULL is returned if any quadrant is NULL or there is no memory, so that failures pass straight up.
+ */
+static Node *join(NodeStore *store, Node *nw, Node *ne, Node *sw, Node *se)
+{
+    Node *quad[4] = {nw, ne, sw, se};
+    if (nw == NULL || ne == NULL || sw == NULL || se == NULL)
+    {
+        return NULL;
+    }
+
+    size_t bucket = hashQuads(quad) & (store->nBuckets - 1);
+    for (Node *node = store->buckets[bucket]; node != NULL; node = node->next)
+    {
+        if (memcmp(node->quad, quad, sizeof(quad)) == 0)
+        {
+            return node;
+        }
+    }
+
+    if (store->blocks == NULL || store->blocks->nUsed == NODES_PER_BLOCK)
+    {
+        NodeBlock *block = malloc(sizeof(NodeBlock));
+        if (block == NULL)
+        {
+            return NULL;
+        }
+        block->prev = store->blocks;
+        block->nUsed = 0;
+        store->blocks = block;
+    }
+    Node *node = &store->blocks->nodes[store->blocks->nUsed++];
+    memcpy(node->quad, quad, sizeof(quad));
+    node->result = NULL;
+    node->resultStep = -1;
+    node->level = nw->level + 1;
+    node->state = DEAD_FACTION;
+    node->next = store->buckets[bucket];
+    store->buckets[bucket] = node;
+
+    store->nNodes++;
+    if ((size_t)store->nNodes > store->nBuckets)
+    {
+        growBuckets(store);
+    }
+    return node;
+}
+
+/**
+ * Returns the node of only WALL cells at level.
+ */
+static Node *wallNode(NodeStore *store, int level)
+{
+    if (level == 0)
+    {
+        return &store->cells[WALL];
+    }
+    if (store->wall[level] == NULL)
+    {
+        Node *quad = wallNode(store, level - 1);
+        store->wall[level] = join(store, quad, quad, quad, quad);
+    }
+    return store->wall[level];
+}
+
+/**
+ * Drops every node but the single cells.
+ */
+static void clearStore(NodeStore *store)
+{
+    while (store->blocks != NULL)
+    {
+        NodeBlock *prev = store->blocks->prev;
+        free(store->blocks);
+        store->blocks = prev;
+    }
+    memset(store->buckets, 0, sizeof(Node *) * store->nBuckets);
+    memset(store->wall, 0, sizeof(store->wall));
+    store->nNodes = 0;
+}
+
+/**
+ * Returns 0 on success and -1 if there is no memory.
+ */
+static int initStore(NodeStore *store)
+{
+    store->nBuckets = MIN_BUCKETS;
+    store->buckets = calloc(store->nBuckets, sizeof(Node *));
+    store->blocks = NULL;
+    store->nNodes = 0;
+    memset(store->wall, 0, sizeof(store->wall));
+    for (int state = 0; state <= WALL; state++)
+    {
+        memset(&store->cells[state], 0, sizeof(Node));
+        store->cells[state].resultStep = -1;
+        store->cells[state].state = state;
+    }
+    return store->buckets != NULL ? 0 : -1;
+}
+
+static void freeStore(NodeStore *store)
+{
+    if (store->buckets != NULL)
+    {
+        clearStore(store);
+    }
+    free(store->buckets);
+}
+
+/**
+ * Computes the next state of the cell at row and col of the 4 by 4 cells, like getNextState does without invaders.
+ * The cell must not be on the border of cells.
+ */
+static int nextCellState(int cells[4][4], int row, int col, bool *diedDueToFighting)
+{
+    *diedDueToFighting = false;
+
+    int cellFaction = cells[row][col];
+    if (cellFaction == WALL)
+    {
+        return WALL;
+    }
+
+    // walls are counted too, but never looked at
+    int neighborCounts[MAX_FACTIONS + 1] = {0};
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            if (dy != 0 || dx != 0)
+            {
+                neighborCounts[cells[row + dy][col + dx]]++;
+            }
+        }
+    }
+
+    if (cellFaction == DEAD_FACTION)
+    {
+        int newFaction = DEAD_FACTION;
+        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+        {
+            if (isBirthable(neighborCounts[faction]))
+            {
+                newFaction = faction;
+            }
+        }
+        return newFaction;
+    }
+
+    int hostileCount = 0;
+    for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+    {
+        if (faction != cellFaction)
+        {
+            hostileCount += neighborCounts[faction];
+        }
+    }
+    if (willFight(hostileCount))
+    {
+        *diedDueToFighting = true;
+        return DEAD_FACTION;
+    }
+    return isSurvivable(neighborCounts[cellFaction]) ? cellFaction : DEAD_FACTION;
+}
+
+/**
+ * Returns the centre 2 by 2 cells of the level 2 node, one generation later, and sets its result.
+ */
+static Node *advanceCells(NodeStore *store, Node *node)
+{
+    int cells[4][4];
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            cells[y][x] = node->quad[y / 2 * 2 + x / 2]->quad[y % 2 * 2 + x % 2]->state;
+        }
+    }
+
+    Node *quad[4];
+    for (int q = 0; q < 4; q++)
+    {
+        bool diedDueToFighting;
+        quad[q] = &store->cells[nextCellState(cells, 1 + q / 2, 1 + q % 2, &diedDueToFighting)];
+        node->resultDeaths[q] = diedDueToFighting;
+    }
+
+    node->result = join(store, quad[0], quad[1], quad[2], quad[3]);
+    node->resultStep = 0;
+    return node->result;
+}
+
+/**
+ * Returns the centre half of node as it is now.
+ */
+static Node *centre(NodeStore *store, const Node *node)
+{
+    return join(store, node->quad[0]->quad[3], node->quad[1]->quad[2], node->quad[2]->quad[1], node->quad[3]->quad[0]);
+}
+
+/**
+ * Returns the centre half of node 2^step generations later, where step is at most node->level - 2, and sets its
+ * result (and resultDeaths). The result only depends on node: no cell outside of it can reach the centre half in time.
+ *
+ * The node is split into a 4 by 4 grid of grandchildren, of which any 2 by 2 block is a node one level down. The 9
+ * overlapping such blocks are first advanced by half the generations (or not at all, if step is below node->level - 2),
+ * which gives a 3 by 3 grid of results that are a quarter of node in size. The 4 overlapping 2 by 2 blocks of those
+ * are then advanced by the other half, and their results are the quadrants of the result.
+ *
+ * Deaths are counted in the quadrants of results, so a quadrant of the result knows the deaths in each part of it
+ * from both halves: the 4 quadrants of its own result, and one quadrant of each of the 4 results of the first half
+ * it overlaps.
+ *
+ * NULL is returned if there is no memory.
+ */
+static Node *advance(NodeStore *store, Node *node, int step)
+{
+    if (node->result != NULL && node->resultStep == step)
+    {
+        return node->result;
+    }
+    if (node->level == 2)
+    {
+        return advanceCells(store, node);
+    }
+
+    Node *grandchildren[4][4];
+    for (int y = 0; y < 4; y++)
+    {
+        for (int x = 0; x < 4; x++)
+        {
+            grandchildren[y][x] = node->quad[y / 2 * 2 + x / 2]->quad[y % 2 * 2 + x % 2];
+        }
+    }
+
+    // a node one level down can only be advanced by half as many generations
+    bool isFullStep = step == node->level - 2;
+    int childStep = isFullStep ? step - 1 : step;
+
+    // the first half
+    Node *halfway[3][3];
+    int halfwayDeaths[3][3][4] = {{{0}}};
+    for (int y = 0; y < 3; y++)
+    {
+        for (int x = 0; x < 3; x++)
+        {
+            Node *block = join(store, grandchildren[y][x], grandchildren[y][x + 1], grandchildren[y + 1][x], grandchildren[y + 1][x + 1]);
+            if (block == NULL)
+            {
+                return NULL;
+            }
+            if (isFullStep)
+            {
+                halfway[y][x] = advance(store, block, childStep);
+                if (halfway[y][x] == NULL)
+                {
+                    return NULL;
+                }
+                memcpy(halfwayDeaths[y][x], block->resultDeaths, sizeof(halfwayDeaths[y][x]));
+            }
+            else
+            {
+                halfway[y][x] = centre(store, block);
+            }
+        }
+    }
+
+    // the second half
+    Node *quad[4];
+    int deaths[4];
+    for (int q = 0; q < 4; q++)
+    {
+        int y = q / 2;
+        int x = q % 2;
+        Node *block = join(store, halfway[y][x], halfway[y][x + 1], halfway[y + 1][x], halfway[y + 1][x + 1]);
+        quad[q] = block != NULL ? advance(store, block, childStep) : NULL;
+        if (quad[q] == NULL)
+        {
+            return NULL;
+        }
+
+        // the deaths in this quadrant: its own result's, then the overlapped quadrants of the first half's results
+        deaths[q] = block->resultDeaths[0] + block->resultDeaths[1] + block->resultDeaths[2] + block->resultDeaths[3];
+        deaths[q] += halfwayDeaths[y][x][3] + halfwayDeaths[y][x + 1][2] + halfwayDeaths[y + 1][x][1] + halfwayDeaths[y + 1][x + 1][0];
+    }
+
+    node->result = join(store, quad[0], quad[1], quad[2], quad[3]);
+    node->resultStep = step;
+    memcpy(node->resultDeaths, deaths, sizeof(deaths));
+    return node->result;
+}
+
+/**
+ * Returns the node at level whose top left cell is at top and left of the root, with the cells of world where it
+ * overlaps the world and WALL everywhere else.
+ */
+static Node *buildNode(Hashlife *life, const PaddedWorld *world, int level, long top, long left)
+{
+    long size = 1L << level;
+    if (top >= life->offset + life->nRows || top + size <= life->offset || left >= life->offset + life->nCols || left + size <= life->offset)
+    {
+        return wallNode(&life->store, level);
+    }
+    if (level == 0)
+    {
+        return &life->store.cells[getPaddedValueAt(world, top - life->offset, left - life->offset)];
+    }
+
+    long half = size / 2;
+    return join(&life->store,
+                buildNode(life, world, level - 1, top, left),
+                buildNode(life, world, level - 1, top, left + half),
+                buildNode(life, world, level - 1, top + half, left),
+                buildNode(life, world, level - 1, top + half, left + half));
+}
+
+/**
+ * Writes the cells of node, whose top left cell is at top and left of the root, that overlap the world into world.
+ */
+static void flattenNode(const Hashlife *life, const Node *node, long top, long left, PaddedWorld *world)
+{
+    long size = 1L << node->level;
+    if (top >= life->offset + life->nRows || top + size <= life->offset || left >= life->offset + life->nCols || left + size <= life->offset)
+    {
+        return;
+    }
+    if (node->level == 0)
+    {
+        setPaddedValueAt(world, top - life->offset, left - life->offset, node->state);
+        return;
+    }
+
+    long half = size / 2;
+    flattenNode(life, node->quad[0], top, left, world);
+    flattenNode(life, node->quad[1], top, left + half, world);
+    flattenNode(life, node->quad[2], top + half, left, world);
+    flattenNode(life, node->quad[3], top + half, left + half, world);
+}
+
+/**
+ * Rebuilds the root from world. Returns 0 on success and -1 if there is no memory.
+ */
+static int setWorld(Hashlife *life, const PaddedWorld *world)
+{
+    life->root = buildNode(life, world, life->root->level, 0, 0);
+    return life->root != NULL ? 0 : -1;
+}
+
+/**
+ * Returns the node at level whose centre half is inner, surrounded by WALL.
+ */
+static Node *surround(NodeStore *store, Node *inner, int level)
+{
+    Node *wall = wallNode(store, level - 2);
+    return join(store,
+                join(store, wall, wall, wall, inner->quad[0]),
+                join(store, wall, wall, inner->quad[1], wall),
+                join(store, wall, inner->quad[2], wall, wall),
+                join(store, inner->quad[3], wall, wall, wall));
+}
+
+/**
+ * Advances the world by 2^step generations. Returns the number of cells that died due to fighting over them, or -1
+ * if there is no memory.
+ *
+ * scratch is only used to rebuild the store once it grows too large.
+ */
+static int stepWorld(Hashlife *life, int step, PaddedWorld *scratch)
+{
+    NodeStore *store = &life->store;
+
+    // only the centre half is advanced, by at most a quarter of the size of the root
+    while (life->root->level < step + 2)
+    {
+        life->offset += 1L << (life->root->level - 1);
+        life->root = surround(store, life->root, life->root->level + 1);
+        if (life->root == NULL)
+        {
+            return -1;
+        }
+    }
+
+    Node *result = advance(store, life->root, step);
+    if (result == NULL)
+    {
+        return -1;
+    }
+    int deaths = life->root->resultDeaths[0] + life->root->resultDeaths[1] + life->root->resultDeaths[2] + life->root->resultDeaths[3];
+
+    // the world moved a quarter of the root up and left with the centre half; this puts it back
+    life->root = surround(store, result, life->root->level);
+    if (life->root == NULL)
+    {
+        return -1;
+    }
+
+    if (store->nNodes > MAX_NODES)
+    {
+        flattenNode(life, life->root, 0, 0, scratch);
+        int level = life->root->level;
+        clearStore(store);
+        life->root = wallNode(store, level);
+        if (life->root == NULL || setWorld(life, scratch) != 0)
+        {
+            return -1;
+        }
+    }
+    return deaths;
+}
+
+/**
+ * Advances the world from generation to target by the largest powers of 2 that fit, adding the deaths to *deathToll.
+ * Returns 0 on success and -1 if there is no memory.
+ */
+static int advanceWorld(Hashlife *life, int generation, int target, int *deathToll, PaddedWorld *scratch)
+{
+    while (generation < target)
+    {
+        int step = 0;
+        while (step < MAX_STEP && (1L << (step + 1)) <= (long)target - generation)
+        {
+            step++;
+        }
+        int deaths = stepWorld(life, step, scratch);
+        if (deaths < 0)
+        {
+            return -1;
+        }
+        *deathToll += deaths;
+        generation += 1 << step;
+    }
+    return 0;
+}
+
+int hashlifeGoi(int nGenerations, const cell_t *startWorld, int nRows, int nCols, InvasionStream *invasions)
+{
+    // the generations with invasions run on padded worlds
+    initKernel();
+
+    // death toll due to fighting
+    int deathToll = 0;
+
+    WorldBuffers worlds;
+    if (initWorldBuffers(&worlds, startWorld, nRows, nCols) != 0)
+    {
+        return -1;
+    }
+
+    Hashlife life;
+    life.nRows = nRows;
+    life.nCols = nCols;
+
+    // the smallest root whose centre half holds the world
+    int level = 2;
+    while ((1L << (level - 1)) < nRows || (1L << (level - 1)) < nCols)
+    {
+        level++;
+    }
+    life.offset = 1L << (level - 2);
+
+    if (initStore(&life.store) != 0 || (life.root = wallNode(&life.store, level)) == NULL || setWorld(&life, worlds.curr) != 0)
+    {
+        freeStore(&life.store);
+        freeWorldBuffers(&worlds);
+        return -1;
+    }
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+    outputPaddedWorld(worlds.curr, 0);
+#endif
+
+    int generation = 0;
+    while (generation < nGenerations)
+    {
+        // the world can be advanced freely up to just before the next invasion; every generation is output, so
+        // then it is advanced one at a time
+        int target = nGenerations;
+        int nextTime = nextInvasionTime(invasions);
+        if (nextTime > generation && nextTime <= nGenerations)
+        {
+            target = nextTime - 1;
+        }
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+        if (target > generation + 1)
+        {
+            target = generation + 1;
+        }
+#endif
+        if (advanceWorld(&life, generation, target, &deathToll, worlds.next) != 0)
+        {
+            deathToll = -1;
+            break;
+        }
+        if (target > generation)
+        {
+            generation = target;
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+            flattenNode(&life, life.root, 0, 0, worlds.curr);
+            outputPaddedWorld(worlds.curr, generation);
+#endif
+            continue;
+        }
+
+        // the invasion lands in the next generation, which is computed cell by cell
+        generation++;
+        const InvasionPlan *invasion = takeInvasionPlan(invasions);
+
+        flattenNode(&life, life.root, 0, 0, worlds.curr);
+        for (int row = 0; row < nRows; row++)
+        {
+            deathToll += nextRowState(worlds.curr, invasion, worlds.next, row, 0, nCols);
+        }
+        swapWorldBuffers(&worlds);
+        if (setWorld(&life, worlds.curr) != 0)
+        {
+            deathToll = -1;
+            break;
+        }
+
+#if PRINT_GENERATIONS || EXPORT_GENERATIONS
+        outputPaddedWorld(worlds.curr, generation);
+#endif
+    }
+
+    freeStore(&life.store);
+    freeWorldBuffers(&worlds);
+    return deathToll;
+}
@@ -0,0 +1,172 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "invasion.h"
+
+/**
+ * Allocates an invasion plan of an nRows by nCols world that lands on no cells yet.
+ *
+ * NULL is returned if there is no memory.
+ */
+InvasionPlan *allocInvasionPlan(int nRows, int nCols)
+{
+    InvasionPlan *plan = malloc(sizeof(InvasionPlan));
+    if (plan == NULL)
+    {
+        return NULL;
+    }
+    plan->nRows = nRows;
+    plan->nCols = nCols;
+    plan->invaders = NULL;
+    plan->nInvaders = 0;
+    plan->capacity = 0;
+    return plan;
+}
+
+/**
+ * Allocates an invasion plan of an nRows by nCols world that lands the nInvaders invaders, which must be in
+ * row-major order, in place (e.g. in a mapped input file). The plan does not own them: no more can be added to it, and
+ * freeInvasionPlan leaves them be.
+ *
+ * NULL is returned if there is no memory.
+ */
+InvasionPlan *viewInvasionPlan(int nRows, int nCols, const Invader *invaders, long nInvaders)
+{
+    InvasionPlan *plan = allocInvasionPlan(nRows, nCols);
+    if (plan == NULL)
+    {
+        return NULL;
+    }
+    plan->invaders = (Invader *)invaders;
+    plan->nInvaders = nInvaders;
+    return plan;
+}
+
+void freeInvasionPlan(InvasionPlan *plan)
+{
+    if (plan == NULL)
+    {
+        return;
+    }
+    if (plan->capacity > 0)
+    {
+        free(plan->invaders);
+    }
+    free(plan);
+}
+
+/**
+ * Adds faction landing on the cell at row and col to plan. Cells must be added in row-major order, each at most once.
+ *
+ * Returns 0 on success, or -1 (leaving plan as it was) if there is no memory.
+ */
+int addInvader(InvasionPlan *plan, int row, int col, int faction)
+{
+    if (plan->nInvaders == plan->capacity)
+    {
+        long capacity = plan->capacity > 0 ? 2 * plan->capacity : 64;
+        Invader *invaders = realloc(plan->invaders, sizeof(Invader) * capacity);
+        if (invaders == NULL)
+        {
+            return -1;
+        }
+        plan->invaders = invaders;
+        plan->capacity = capacity;
+    }
+
+    Invader *invader = &plan->invaders[plan->nInvaders++];
+    invader->row = row;
+    invader->col = col;
+    invader->faction = faction;
+    return 0;
+}
+
+/**
+ * Adds the invaders of more to plan. They must all come after those of plan in row-major order.
+ *
+ * Returns 0 on success, or -1 (leaving plan as it was) if there is no memory.
+ */
+int appendInvaders(InvasionPlan *plan, const InvasionPlan *more)
+{
+    if (more->nInvaders == 0)
+    {
+        return 0;
+    }
+    if (plan->nInvaders + more->nInvaders > plan->capacity)
+    {
+        long capacity = 2 * plan->capacity > plan->nInvaders + more->nInvaders ? 2 * plan->capacity : plan->nInvaders + more->nInvaders;
+        Invader *invaders = realloc(plan->invaders, sizeof(Invader) * capacity);
+        if (invaders == NULL)
+        {
+            return -1;
+        }
+        plan->invaders = invaders;
+        plan->capacity = capacity;
+    }
+
+    memcpy(plan->invaders + plan->nInvaders, more->invaders, sizeof(Invader) * more->nInvaders);
+    plan->nInvaders += more->nInvaders;
+    return 0;
+}
+
+/**
+ * Returns the first invader of plan at or after the cell at row and col in row-major order, or endInvaders(plan) if
+ * there is none.
+ */
+const Invader *findInvader(const InvasionPlan *plan, int row, int col)
+{
+    long first = 0;
+    long last = plan->nInvaders;
+    while (first < last)
+    {
+        long mid = first + (last - first) / 2;
+        const Invader *invader = &plan->invaders[mid];
+        if (invader->row < row || (invader->row == row && invader->col < col))
+        {
+            first = mid + 1;
+        }
+        else
+        {
+            last = mid;
+        }
+    }
+    return plan->invaders + first;
+}
+
+/**
+ * Returns the largest faction that plan lands, or DEAD_FACTION if it lands none.
+ */
+int maxInvaderFaction(const InvasionPlan *plan)
+{
+    int maxFaction = DEAD_FACTION;
+    for (long i = 0; i < plan->nInvaders; i++)
+    {
+        if (plan->invaders[i].faction > maxFaction)
+        {
+            maxFaction = plan->invaders[i].faction;
+        }
+    }
+    return maxFaction;
+}
+
+/**
+ * Writes plan to stdout as a whole grid, like printWorld does for a world.
+ */
+void printInvasionPlan(const InvasionPlan *plan)
+{
+    const Invader *invader = plan->invaders;
+    for (int row = 0; row < plan->nRows; row++)
+    {
+        for (int col = 0; col < plan->nCols; col++)
+        {
+            int faction = DEAD_FACTION;
+            if (invader != endInvaders(plan) && invader->row == row && invader->col == col)
+            {
+                faction = invader->faction;
+                invader++;
+            }
+            printf("%d ", faction);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,30 @@
+#ifndef KERNEL_H
+#define KERNEL_H
+
+#include <stdbool.h>
+#include "grid.h"
+#include "invasion.h"
+
+/**
+ * The implementations of nextRowState, from slowest to fastest.
+ */
+typedef enum RowKernelKind {
+    ROW_KERNEL_SCALAR,
+    ROW_KERNEL_SLIDING,
+    ROW_KERNEL_SSE42,
+    ROW_KERNEL_AVX2,
+    ROW_KERNEL_AVX512
+} RowKernelKind;
+
+void initKernel(void);
+RowKernelKind getRowKernelKind(void);
+const char *getRowKernelName(void);
+
+bool isBirthable(int n);
+bool isSurvivable(int n);
+bool willFight(int n);
+int getNextState(const PaddedWorld *currWorld, int row, int col, bool *diedDueToFighting);
+int landInvader(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int col, int faction);
+int nextRowState(const PaddedWorld *currWorld, const InvasionPlan *invaders, PaddedWorld *nextWorld, int row, int colStart, int colEnd);
+
+#endif
@@ -0,0 +1,164 @@
+/**
+ * The vector row kernel, written once for any vector width.
+ *
+ * This file has no include guard: kernel.c includes it once per instruction set, after defining
+ * VEC_CELLS (cells per vector, i.e. the register width in bytes) and VEC(name) (which suffixes every name
+ * so that the instantiations do not clash), and with the matching "#pragma GCC target" in effect.
+ *
+ * Vectors are only ever passed by pointer so that no function's ABI depends on the target it is compiled for.
+ */
+
+typedef uint8_t VEC(CellVec) __attribute__((vector_size(VEC_CELLS)));
+
+#ifndef SELECT_CELLS
+// lanes hold 0xff for true and 0x00 for false; picks a where mask is true and b elsewhere
+#define SELECT_CELLS(mask, a, b) (((mask) & (a)) | (~(mask) & (b)))
+#endif
+
+/**
+ * Returns the bitwise OR of all lanes of v.
+ */
+static inline int VEC(orLanes)(const VEC(CellVec) *v)
+{
+    uint64_t words[VEC_CELLS / 8];
+    memcpy(words, v, sizeof(words));
+    uint64_t acc = 0;
+    for (int i = 0; i < VEC_CELLS / 8; i++)
+    {
+        acc |= words[i];
+    }
+    acc |= acc >> 32;
+    acc |= acc >> 16;
+    acc |= acc >> 8;
+    return acc & 0xff;
+}
+
+/**
+ * Returns the number of set lanes of mask.
+ */
+static inline int VEC(countLanes)(const VEC(CellVec) *mask)
+{
+    uint64_t words[VEC_CELLS / 8];
+    memcpy(words, mask, sizeof(words));
+    int bits = 0;
+    for (int i = 0; i < VEC_CELLS / 8; i++)
+    {
+        bits += __builtin_popcountll(words[i]);
+    }
+    return bits / 8;
+}
+
+/**
+ * Computes the next state of the VEC_CELLS cells of a row starting at col into *next, and which of them count
+ * towards the death toll due to fighting into *fight. up, mid and down are the rows above, of and below the
+ * cells.
+ *
+ * Rather than building a histogram per cell, it counts, for each faction that can be present, how many of the
+ * 8 neighbours of every lane belong to it. This applies the same rules as isBirthable, isSurvivable and
+ * willFight, expressed as lane-wise masks.
+ */
+static inline void VEC(nextBlockState)(const cell_t *up, const cell_t *mid, const cell_t *down, int col, VEC(CellVec) *next, VEC(CellVec) *fight)
+{
+    const VEC(CellVec) zero = {0};
+    const VEC(CellVec) two = zero + 2;
+    const VEC(CellVec) three = zero + 3;
+
+    VEC(CellVec) neighbors[8];
+    memcpy(&neighbors[0], up + col - 1, sizeof(zero));
+    memcpy(&neighbors[1], up + col, sizeof(zero));
+    memcpy(&neighbors[2], up + col + 1, sizeof(zero));
+    memcpy(&neighbors[3], mid + col - 1, sizeof(zero));
+    memcpy(&neighbors[4], mid + col + 1, sizeof(zero));
+    memcpy(&neighbors[5], down + col - 1, sizeof(zero));
+    memcpy(&neighbors[6], down + col, sizeof(zero));
+    memcpy(&neighbors[7], down + col + 1, sizeof(zero));
+    VEC(CellVec) self;
+    memcpy(&self, mid + col, sizeof(self));
+
+    // every faction in this block is at most the OR of all of them, which is usually far below MAX_FACTIONS
+    VEC(CellVec) present = self;
+    for (int n = 0; n < 8; n++)
+    {
+        present |= neighbors[n];
+    }
+    int maxFaction = VEC(orLanes)(&present);
+    if (maxFaction == DEAD_FACTION)
+    {
+        // nothing alive: stays dead
+        *next = zero;
+        *fight = zero;
+        return;
+    }
+    if (maxFaction >= MAX_FACTIONS)
+    {
+        maxFaction = MAX_FACTIONS - 1;
+    }
+
+    // subtracting a mask (0xff is -1) counts its true lanes
+    VEC(CellVec) liveCount = zero;
+    for (int n = 0; n < 8; n++)
+    {
+        liveCount -= (VEC(CellVec))(neighbors[n] != zero);
+    }
+
+    VEC(CellVec) friendlyCount = zero;
+    VEC(CellVec) born = zero;
+    for (int faction = DEAD_FACTION + 1; faction <= maxFaction; faction++)
+    {
+        VEC(CellVec) f = zero + (cell_t)faction;
+        VEC(CellVec) count = zero;
+        for (int n = 0; n < 8; n++)
+        {
+            count -= (VEC(CellVec))(neighbors[n] == f);
+        }
+        // a later (higher) faction overwrites an earlier one, just like getNextState
+        born = SELECT_CELLS((VEC(CellVec))(count == three), f, born);
+        friendlyCount = SELECT_CELLS((VEC(CellVec))(self == f), count, friendlyCount);
+    }
+
+    VEC(CellVec) alive = (VEC(CellVec))(self != zero);
+    VEC(CellVec) fighting = alive & (VEC(CellVec))(liveCount != friendlyCount);
+    VEC(CellVec) survives = alive & ~fighting & ((VEC(CellVec))(friendlyCount == two) | (VEC(CellVec))(friendlyCount == three));
+    *fight = fighting;
+    *next = SELECT_CELLS(alive, survives & self, born);
+}
+
+/**
+ * The vector equivalent of scalarRowKernel, computing VEC_CELLS cells per iteration.
+ *
+ * The last, partial block is computed as a whole one and only its first (colEnd - col) lanes are kept. The lanes
+ * past colEnd read other cells of the padded world, or the slack that allocPaddedWorld leaves at its end.
+ */
+static int VEC(vectorRowKernel)(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int colStart, int colEnd)
+{
+    const cell_t *up = paddedRow(currWorld, row - 1);
+    const cell_t *mid = paddedRow(currWorld, row);
+    const cell_t *down = paddedRow(currWorld, row + 1);
+    cell_t *newRow = paddedRow(nextWorld, row);
+
+    VEC(CellVec) next, fight;
+    int deaths = 0;
+    int col = colStart;
+    for (; col + VEC_CELLS <= colEnd; col += VEC_CELLS)
+    {
+        VEC(nextBlockState)(up, mid, down, col, &next, &fight);
+        memcpy(newRow + col, &next, sizeof(next));
+        deaths += VEC(countLanes)(&fight);
+    }
+
+    if (col < colEnd)
+    {
+        int remaining = colEnd - col;
+        VEC(nextBlockState)(up, mid, down, col, &next, &fight);
+        memcpy(newRow + col, &next, remaining);
+
+        cell_t fightLanes[VEC_CELLS];
+        memcpy(fightLanes, &fight, sizeof(fightLanes));
+        for (int lane = 0; lane < remaining; lane++)
+        {
+            deaths += fightLanes[lane] != 0;
+        }
+    }
+
+    return deaths;
+}
@@ -0,0 +1,727 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "parse.h"
+#include "placement.h"
+#include "settings.h"
+
+/**
+ * The whole text of an input file, and where each of its lines starts.
+ */
+typedef struct TextFile {
+    const char *text;
+    size_t size;
+    // whether text is a mapping of the file, rather than a copy of it
+    bool isMapped;
+    // line i is text[lineStarts[i]] up to (and including) its newline; lineStarts[nLines] is where the first line
+    // that is not indexed yet starts (size once every line is)
+    size_t *lineStarts;
+    long nLines;
+    long capacity;
+} TextFile;
+
+/**
+ * Rows [rowStart, rowEnd) of the start world or of an invasion plan, to be parsed by one thread.
+ */
+typedef struct ParseChunk {
+    // the invasion the rows are of, or -1 for the start world
+    int invasion;
+    int rowStart;
+    int rowEnd;
+    // the line rowStart is on
+    long firstLine;
+    // the invaders of the rows, if they are of an invasion plan
+    InvasionPlan *invaders;
+    // the first row that could not be parsed, or -1 if there is none
+    int failedRow;
+} ParseChunk;
+
+/**
+ * Every chunk of a file, in file order.
+ */
+typedef struct ParseJob {
+    TextFile *file;
+    GoiInput *input;
+    ParseChunk *chunks;
+    int nChunks;
+    int capacity;
+    // the next chunk for a thread to take
+    int nextChunk;
+    // the first line that has not been planned
+    long line;
+} ParseJob;
+
+/**
+ * A text input file that is read a part at a time: first up to its start world, on several threads, and then one
+ * invasion time and plan after the other.
+ */
+struct TextInput {
+    TextFile file;
+    // the first line that has not been read
+    long line;
+    // the text before this has been read and given back (if it is mapped)
+    size_t released;
+    int nRows;
+    int nCols;
+    // room for one row
+    cell_t *rowCells;
+};
+
+/**
+ * Returns whether c is white space, as isspace does in the "C" locale.
+ */
+static inline bool isSpace(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool isDigit(char c)
+{
+    return (unsigned char)(c - '0') < 10;
+}
+
+/**
+ * Maps fp into file, or reads it whole if it cannot be mapped (e.g. if it is a pipe). No line is indexed yet.
+ *
+ * Returns 0 on success, or -1 if there is no memory.
+ */
+static int loadTextFile(FILE *fp, TextFile *file)
+{
+    memset(file, 0, sizeof(TextFile));
+
+    struct stat st;
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0)
+    {
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+        if (mapping != MAP_FAILED)
+        {
+            // the lines are indexed front to back
+            madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+            file->text = mapping;
+            file->size = st.st_size;
+            file->isMapped = true;
+        }
+    }
+    if (!file->isMapped)
+    {
+        size_t capacity = 0;
+        char *text = NULL;
+        for (;;)
+        {
+            if (file->size == capacity)
+            {
+                capacity = capacity > 0 ? 2 * capacity : 1 << 20;
+                char *grown = realloc(text, capacity);
+                if (grown == NULL)
+                {
+                    free(text);
+                    return -1;
+                }
+                text = grown;
+            }
+            size_t nRead = fread(text + file->size, 1, capacity - file->size, fp);
+            if (nRead == 0)
+            {
+                break;
+            }
+            file->size += nRead;
+        }
+        file->text = text;
+    }
+
+    file->capacity = 1024;
+    file->lineStarts = malloc(sizeof(size_t) * file->capacity);
+    if (file->lineStarts == NULL)
+    {
+        return -1;
+    }
+    file->lineStarts[0] = 0;
+    return 0;
+}
+
+/**
+ * Indexes the lines of file up to line nLines, or all of them if it has fewer. Lines that are already indexed are
+ * not looked at again, so a file is indexed in one pass however many calls that takes.
+ *
+ * Returns 0 on success, or -1 if there is no memory.
+ */
+static int indexLines(TextFile *file, long nLines)
+{
+    size_t at = file->lineStarts[file->nLines];
+    while (file->nLines < nLines && at < file->size)
+    {
+        if (file->nLines + 1 == file->capacity)
+        {
+            size_t *grown = realloc(file->lineStarts, sizeof(size_t) * 2 * file->capacity);
+            if (grown == NULL)
+            {
+                return -1;
+            }
+            file->lineStarts = grown;
+            file->capacity *= 2;
+        }
+        const char *newline = memchr(file->text + at, '\n', file->size - at);
+        at = newline != NULL ? (size_t)(newline - file->text) + 1 : file->size;
+        file->lineStarts[++file->nLines] = at;
+    }
+    return 0;
+}
+
+/**
+ * Returns whether file has the lines up to line nLines, indexing them if need be.
+ */
+static inline bool hasLines(TextFile *file, long nLines)
+{
+    return indexLines(file, nLines) == 0 && file->nLines >= nLines;
+}
+
+static void unloadTextFile(TextFile *file)
+{
+    if (file->isMapped)
+    {
+        munmap((void *)file->text, file->size);
+    }
+    else
+    {
+        free((void *)file->text);
+    }
+    free(file->lineStarts);
+}
+
+/**
+ * Parses the one integer at the start of line into *param, like sscanf's "%d" does.
+ *
+ * -1 is returned on error, including if the file has no such line.
+ */
+static int parseParam(TextFile *file, long line, int *param)
+{
+    if (!hasLines(file, line + 1))
+    {
+        return -1;
+    }
+    const char *p = file->text + file->lineStarts[line];
+    const char *end = file->text + file->lineStarts[line + 1];
+
+    while (p < end && isSpace(*p))
+    {
+        p++;
+    }
+    bool isNegative = p < end && *p == '-';
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        p++;
+    }
+    if (p == end || !isDigit(*p))
+    {
+        return -1;
+    }
+
+    long value = 0;
+    while (p < end && isDigit(*p))
+    {
+        value = 10 * value + (*p - '0');
+        if (value > (long)INT_MAX + 1)
+        {
+            return -1;
+        }
+        p++;
+    }
+    if (isNegative)
+    {
+        value = -value;
+    }
+    if (value > INT_MAX)
+    {
+        return -1;
+    }
+    *param = (int)value;
+    return 0;
+}
+
+/**
+ * Parses the nCols cells of the line [p, end) into rowCells, accepting the same text as strtol would. Anything after
+ * the last cell is ignored.
+ *
+ * -1 is returned on error.
+ */
+static int parseRow(const char *p, const char *end, cell_t *rowCells, int nCols)
+{
+    for (int col = 0; col < nCols; col++)
+    {
+        while (p < end && isSpace(*p))
+        {
+            p++;
+        }
+        bool isNegative = p < end && *p == '-';
+        if (p < end && (*p == '-' || *p == '+'))
+        {
+            p++;
+        }
+
+        // unexpected end
+        if (p == end || !isDigit(*p))
+        {
+            return -1;
+        }
+
+        // stops growing once it is not a faction, so it cannot overflow
+        int cell = 0;
+        while (p < end && isDigit(*p))
+        {
+            if (cell < MAX_FACTIONS)
+            {
+                cell = 10 * cell + (*p - '0');
+            }
+            p++;
+        }
+
+        // not a faction; this also guarantees the cell fits in a cell_t
+        if ((isNegative && cell != DEAD_FACTION) || cell >= MAX_FACTIONS)
+        {
+            return -1;
+        }
+
+        rowCells[col] = cell;
+    }
+
+    return 0;
+}
+
+/**
+ * Adds the rows of the start world (invasion -1) or of an invasion plan, whose first row is on firstLine, to job as
+ * chunks of about PARSE_CHUNK_BYTES.
+ *
+ * Returns 0 on success, or -1 if there is no memory.
+ */
+static int addChunks(ParseJob *job, int invasion, long firstLine)
+{
+    int nRows = job->input->nRows;
+    // a row of nCols cells takes at least 2 bytes a cell
+    long rowsPerChunk = PARSE_CHUNK_BYTES / (2L * job->input->nCols);
+    if (rowsPerChunk < 1)
+    {
+        rowsPerChunk = 1;
+    }
+
+    for (long rowStart = 0; rowStart < nRows; rowStart += rowsPerChunk)
+    {
+        if (job->nChunks == job->capacity)
+        {
+            int capacity = job->capacity > 0 ? 2 * job->capacity : 64;
+            ParseChunk *chunks = realloc(job->chunks, sizeof(ParseChunk) * capacity);
+            if (chunks == NULL)
+            {
+                return -1;
+            }
+            job->chunks = chunks;
+            job->capacity = capacity;
+        }
+
+        ParseChunk *chunk = &job->chunks[job->nChunks];
+        chunk->invasion = invasion;
+        chunk->rowStart = rowStart;
+        chunk->rowEnd = rowStart + rowsPerChunk < nRows ? rowStart + rowsPerChunk : nRows;
+        chunk->firstLine = firstLine + rowStart;
+        chunk->failedRow = -1;
+        chunk->invaders = NULL;
+        if (invasion >= 0 && (chunk->invaders = allocInvasionPlan(nRows, job->input->nCols)) == NULL)
+        {
+            return -1;
+        }
+        job->nChunks++;
+    }
+    return 0;
+}
+
+/**
+ * Reads the sizes and the number of invasions of the file of job into its input, allocates the start world and adds
+ * its rows to job as chunks. job->line is left on the first invasion.
+ *
+ * Returns NULL on success. Otherwise, it returns the error message of the first part of the file that is wrong,
+ * after adding the chunks of all the parts before it.
+ */
+static const char *planStart(ParseJob *job)
+{
+    TextFile *file = job->file;
+    GoiInput *input = job->input;
+
+    // Read nGenerations, nRows and nCols
+    if (parseParam(file, 0, &input->nGenerations) == -1)
+    {
+        return "Failed to read N_GENERATIONS. Aborting...\n";
+    }
+    if (parseParam(file, 1, &input->nRows) == -1)
+    {
+        return "Failed to read N_ROWS. Aborting...\n";
+    }
+    if (parseParam(file, 2, &input->nCols) == -1)
+    {
+        return "Failed to read N_COLS. Aborting...\n";
+    }
+    int nRows = input->nRows;
+    int nCols = input->nCols;
+    if (nRows == 0 || nCols == 0)
+    {
+        return "N_ROWS or N_COLS is 0. Aborting...\n";
+    }
+
+    // Read start world; it is read by every thread, so it is spread across NUMA nodes
+    long line = 3;
+    input->startWorld = nRows > 0 && nCols > 0 ? allocPlacedMemory(sizeof(cell_t) * nRows * nCols, true) : NULL;
+    input->ownsStartWorld = true;
+    if (input->startWorld == NULL || !hasLines(file, line + nRows) || addChunks(job, -1, line) == -1)
+    {
+        return "Failed to read STARTING_WORLD. Aborting...\n";
+    }
+    line += nRows;
+
+    // Read nInvasions
+    if (parseParam(file, line, &input->nInvasions) == -1)
+    {
+        return "Failed to read N_INVASIONS. Aborting...\n";
+    }
+    job->line = line + 1;
+    return NULL;
+}
+
+/**
+ * Plans the start world of the file of job with planStart, then reads its invasion times into its input, allocates
+ * the invasion plans and adds the rows of each of them to job as chunks. This takes time in proportion to the number
+ * of rows and invasions, not to the size of the file (once its lines are indexed).
+ *
+ * Returns NULL on success, or an error message like planStart.
+ */
+static const char *planChunks(ParseJob *job)
+{
+    const char *error = planStart(job);
+    if (error != NULL)
+    {
+        return error;
+    }
+
+    TextFile *file = job->file;
+    GoiInput *input = job->input;
+    int nRows = input->nRows;
+    int nCols = input->nCols;
+    int nInvasions = input->nInvasions;
+    long line = job->line;
+
+    // Read invasions
+    input->invasionTimes = nInvasions >= 0 ? malloc(sizeof(int) * nInvasions) : NULL;
+    input->invasionPlans = nInvasions >= 0 ? calloc(nInvasions, sizeof(InvasionPlan *)) : NULL;
+    if (input->invasionTimes == NULL || input->invasionPlans == NULL)
+    {
+        return "No memory for invasions. Aborting...\n";
+    }
+    for (int i = 0; i < nInvasions; i++)
+    {
+        if (parseParam(file, line, input->invasionTimes + i) == -1)
+        {
+            return "Failed to read INVASION_TIME. Aborting...\n";
+        }
+        line++;
+
+        input->invasionPlans[i] = allocInvasionPlan(nRows, nCols);
+        if (input->invasionPlans[i] == NULL || !hasLines(file, line + nRows) || addChunks(job, i, line) == -1)
+        {
+            return "Failed to read INVASION_PLAN. Aborting...\n";
+        }
+        line += nRows;
+    }
+    return NULL;
+}
+
+/**
+ * Parses the rows of chunk, into the start world or into the chunk's own invaders. rowCells has room for one row.
+ */
+static void parseChunk(const ParseJob *job, ParseChunk *chunk, cell_t *rowCells)
+{
+    const TextFile *file = job->file;
+    int nCols = job->input->nCols;
+    for (int row = chunk->rowStart; row < chunk->rowEnd; row++)
+    {
+        long line = chunk->firstLine + row - chunk->rowStart;
+        const char *p = file->text + file->lineStarts[line];
+        const char *end = file->text + file->lineStarts[line + 1];
+
+        if (chunk->invasion < 0)
+        {
+            if (parseRow(p, end, job->input->startWorld + (long)row * nCols, nCols) == -1)
+            {
+                chunk->failedRow = row;
+                return;
+            }
+            continue;
+        }
+
+        if (rowCells == NULL || parseRow(p, end, rowCells, nCols) == -1)
+        {
+            chunk->failedRow = row;
+            return;
+        }
+        for (int col = 0; col < nCols; col++)
+        {
+            if (rowCells[col] != DEAD_FACTION && addInvader(chunk->invaders, row, col, rowCells[col]) == -1)
+            {
+                chunk->failedRow = row;
+                return;
+            }
+        }
+    }
+}
+
+/**
+ * Parses chunks of job until there are none left. Run by every thread.
+ */
+static void *parseChunks(void *args)
+{
+    ParseJob *job = args;
+    cell_t *rowCells = malloc(sizeof(cell_t) * job->input->nCols);
+    for (;;)
+    {
+        int c = __atomic_fetch_add(&job->nextChunk, 1, __ATOMIC_RELAXED);
+        if (c >= job->nChunks)
+        {
+            break;
+        }
+        parseChunk(job, &job->chunks[c], rowCells);
+    }
+    free(rowCells);
+    return NULL;
+}
+
+/**
+ * Parses the chunks of job on up to nThreads threads, the calling one included.
+ */
+static void runParseJob(ParseJob *job, int nThreads)
+{
+    int nWorkers = nThreads < job->nChunks ? nThreads : job->nChunks;
+    pthread_t *workers = malloc(sizeof(pthread_t) * (nWorkers > 1 ? nWorkers - 1 : 1));
+    int nStarted = 0;
+    while (workers != NULL && nStarted < nWorkers - 1 && pthread_create(&workers[nStarted], NULL, parseChunks, job) == 0)
+    {
+        nStarted++;
+    }
+    parseChunks(job);
+    for (int t = 0; t < nStarted; t++)
+    {
+        pthread_join(workers[t], NULL);
+    }
+    free(workers);
+}
+
+/**
+ * Parses fp, an input file of the text format, into input on up to nThreads threads (see parse.h).
+ *
+ * Returns 0 on success, or -1 after printing what went wrong to stderr. input must then still be freed.
+ */
+int parseTextInput(FILE *fp, int nThreads, GoiInput *input)
+{
+    memset(input, 0, sizeof(GoiInput));
+#if REPORT_PARSE_THROUGHPUT
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
+
+    TextFile file;
+    if (loadTextFile(fp, &file) == -1)
+    {
+        fprintf(stderr, "No memory for the input. Aborting...\n");
+        unloadTextFile(&file);
+        return -1;
+    }
+
+    // every line is indexed in one pass before any chunk is planned
+    ParseJob job;
+    memset(&job, 0, sizeof(ParseJob));
+    job.file = &file;
+    job.input = input;
+    const char *planError = indexLines(&file, LONG_MAX) == 0 ? planChunks(&job) : "No memory for the input. Aborting...\n";
+    runParseJob(&job, nThreads);
+
+    // the chunks are in file order, and all come before the part that planError is about
+    const char *error = NULL;
+    for (int c = 0; c < job.nChunks && error == NULL; c++)
+    {
+        if (job.chunks[c].failedRow >= 0)
+        {
+            error = job.chunks[c].invasion < 0 ? "Failed to read STARTING_WORLD. Aborting...\n" : "Failed to read INVASION_PLAN. Aborting...\n";
+        }
+    }
+    if (error == NULL)
+    {
+        error = planError;
+    }
+
+    // join up the invaders of every plan
+    for (int c = 0; c < job.nChunks; c++)
+    {
+        ParseChunk *chunk = &job.chunks[c];
+        if (error == NULL && chunk->invasion >= 0 && appendInvaders(input->invasionPlans[chunk->invasion], chunk->invaders) == -1)
+        {
+            error = "No memory for invasions. Aborting...\n";
+        }
+        freeInvasionPlan(chunk->invaders);
+    }
+    free(job.chunks);
+
+    if (error != NULL)
+    {
+        fputs(error, stderr);
+        unloadTextFile(&file);
+        return -1;
+    }
+
+#if REPORT_PARSE_THROUGHPUT
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("Parsed %.1f MB of input in %.3f s (%.1f MB/s) on %d threads\n", file.size / 1e6, seconds, file.size / 1e6 / seconds, nThreads);
+#endif
+    unloadTextFile(&file);
+    return 0;
+}
+
+/**
+ * Parses fp, an input file of the text format, into input up to its start world, on up to nThreads threads like
+ * parseTextInput. Its invasions are left to be read one at a time, with parseInvasionTime and parseInvasionPlan:
+ * input gets their number, but not their times or plans.
+ *
+ * Returns the rest of the file, to be closed with closeTextInput, or NULL after printing what went wrong to stderr.
+ * input must be freed either way.
+ */
+TextInput *openTextInput(FILE *fp, int nThreads, GoiInput *input)
+{
+    memset(input, 0, sizeof(GoiInput));
+#if REPORT_PARSE_THROUGHPUT
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+#endif
+
+    TextInput *text = calloc(1, sizeof(TextInput));
+    if (text == NULL || loadTextFile(fp, &text->file) == -1)
+    {
+        fprintf(stderr, "No memory for the input. Aborting...\n");
+        closeTextInput(text);
+        return NULL;
+    }
+
+    ParseJob job;
+    memset(&job, 0, sizeof(ParseJob));
+    job.file = &text->file;
+    job.input = input;
+    const char *error = planStart(&job);
+    runParseJob(&job, nThreads);
+
+    for (int c = 0; c < job.nChunks && error == NULL; c++)
+    {
+        if (job.chunks[c].failedRow >= 0)
+        {
+            error = "Failed to read STARTING_WORLD. Aborting...\n";
+        }
+    }
+    free(job.chunks);
+    if (error == NULL && (input->nInvasions < 0 || (text->rowCells = malloc(sizeof(cell_t) * input->nCols)) == NULL))
+    {
+        error = "No memory for invasions. Aborting...\n";
+    }
+
+    if (error != NULL)
+    {
+        fputs(error, stderr);
+        closeTextInput(text);
+        return NULL;
+    }
+
+#if REPORT_PARSE_THROUGHPUT
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    size_t size = text->file.lineStarts[job.line];
+    printf("Parsed %.1f MB of input in %.3f s (%.1f MB/s) on %d threads\n", size / 1e6, seconds, size / 1e6 / seconds, nThreads);
+#endif
+    text->line = job.line;
+    text->nRows = input->nRows;
+    text->nCols = input->nCols;
+    return text;
+}
+
+/**
+ * Parses the time of the next invasion of text into *time.
+ *
+ * Returns NULL on success, or the message of what went wrong (see planChunks).
+ */
+const char *parseInvasionTime(TextInput *text, int *time)
+{
+    if (parseParam(&text->file, text->line, time) == -1)
+    {
+        return "Failed to read INVASION_TIME. Aborting...\n";
+    }
+    text->line++;
+    return NULL;
+}
+
+/**
+ * Parses the plan of the invasion whose time was parsed last into a new plan, at *plan.
+ *
+ * Returns NULL on success, or the message of what went wrong (see planChunks).
+ */
+const char *parseInvasionPlan(TextInput *text, InvasionPlan **plan)
+{
+    InvasionPlan *read = allocInvasionPlan(text->nRows, text->nCols);
+    if (read == NULL || !hasLines(&text->file, text->line + text->nRows))
+    {
+        freeInvasionPlan(read);
+        return "Failed to read INVASION_PLAN. Aborting...\n";
+    }
+
+    for (int row = 0; row < text->nRows; row++)
+    {
+        const char *p = text->file.text + text->file.lineStarts[text->line + row];
+        const char *end = text->file.text + text->file.lineStarts[text->line + row + 1];
+        if (parseRow(p, end, text->rowCells, text->nCols) == -1)
+        {
+            freeInvasionPlan(read);
+            return "Failed to read INVASION_PLAN. Aborting...\n";
+        }
+        for (int col = 0; col < text->nCols; col++)
+        {
+            if (text->rowCells[col] != DEAD_FACTION && addInvader(read, row, col, text->rowCells[col]) == -1)
+            {
+                freeInvasionPlan(read);
+                return "Failed to read INVASION_PLAN. Aborting...\n";
+            }
+        }
+    }
+    text->line += text->nRows;
+    *plan = read;
+
+    // the pages of the text read so far are not needed again
+    if (text->file.isMapped)
+    {
+        size_t pageSize = sysconf(_SC_PAGESIZE);
+        size_t upTo = text->file.lineStarts[text->line] & ~(pageSize - 1);
+        if (upTo > text->released)
+        {
+            madvise((char *)text->file.text + text->released, upTo - text->released, MADV_DONTNEED);
+            text->released = upTo;
+        }
+    }
+    return NULL;
+}
+
+void closeTextInput(TextInput *text)
+{
+    if (text == NULL)
+    {
+        return;
+    }
+    unloadTextFile(&text->file);
+    free(text->rowCells);
+    free(text);
+}
@@ -0,0 +1,240 @@
+#include <stdlib.h>
+#include <string.h>
+#include "sparse.h"
+#include "kernel.h"
+
+/**
+ * Allocates the sparse engine of an nRows by nCols world. It starts out inactive, and first checks the world for
+ * sparseness in the first generation.
+ *
+ * NULL is returned if there is no memory.
+ */
+SparseEngine *allocSparseEngine(int nRows, int nCols)
+{
+    SparseEngine *sparse = calloc(1, sizeof(SparseEngine));
+    if (sparse == NULL)
+    {
+        return NULL;
+    }
+
+    long nCells = (long)nRows * nCols;
+    sparse->nRows = nRows;
+    sparse->nCols = nCols;
+    sparse->isActive = false;
+    sparse->sinceCheck = SPARSE_CHECK_INTERVAL;
+    // every live cell of a world the engine keeps has at most 9 candidates; so has every cell of the next world
+    sparse->capacity = 9 * (nCells / SPARSE_LEAVE_CELLS_PER_LIVE + 1);
+    sparse->live = malloc(sizeof(long) * sparse->capacity);
+    sparse->lastLive = malloc(sizeof(long) * sparse->capacity);
+    sparse->candidates = malloc(sizeof(long) * sparse->capacity);
+    sparse->marks = calloc((nCells + 63) / 64, sizeof(uint64_t));
+    if (sparse->live == NULL || sparse->lastLive == NULL || sparse->candidates == NULL || sparse->marks == NULL)
+    {
+        freeSparseEngine(sparse);
+        return NULL;
+    }
+    return sparse;
+}
+
+void freeSparseEngine(SparseEngine *sparse)
+{
+    if (sparse == NULL)
+    {
+        return;
+    }
+    free(sparse->live);
+    free(sparse->lastLive);
+    free(sparse->candidates);
+    free(sparse->marks);
+    free(sparse);
+}
+
+/**
+ * Returns the hash of a live cell at index with faction; a world hashes to the sum over its live cells.
+ */
+static uint64_t hashCell(long index, int faction)
+{
+    // the splitmix64 finalizer
+    uint64_t hash = (uint64_t)index * MAX_FACTIONS + faction;
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+/**
+ * Takes over worlds if its current world is sparse enough: lists its live cells and clears the next world.
+ *
+ * Returns true if it did.
+ */
+static bool enterSparse(SparseEngine *sparse, WorldBuffers *worlds)
+{
+    const PaddedWorld *world = worlds->curr;
+    long nCells = (long)sparse->nRows * sparse->nCols;
+    long maxLive = nCells / SPARSE_ENTER_CELLS_PER_LIVE;
+
+    long nLive = 0;
+    uint64_t hash = 0;
+    for (int row = 0; row < sparse->nRows; row++)
+    {
+        const cell_t *cells = paddedRow(world, row);
+        for (int col = 0; col < sparse->nCols; col++)
+        {
+            if (cells[col] == DEAD_FACTION)
+            {
+                continue;
+            }
+            if (nLive == maxLive)
+            {
+                return false;
+            }
+            long index = (long)row * sparse->nCols + col;
+            sparse->live[nLive++] = index;
+            hash += hashCell(index, cells[col]);
+        }
+    }
+
+    // the halo is dead already
+    for (int row = 0; row < sparse->nRows; row++)
+    {
+        memset(paddedRow(worlds->next, row), DEAD_FACTION, sizeof(cell_t) * sparse->nCols);
+    }
+    sparse->nLive = nLive;
+    sparse->nLastLive = 0;
+    sparse->hash = hash;
+    sparse->isActive = true;
+    return true;
+}
+
+/**
+ * Hands world, the current world from the next generation on, back to the dense engine.
+ */
+static void leaveSparse(SparseEngine *sparse, TileMap *tiles, const PaddedWorld *world)
+{
+    resetTileMap(tiles, world);
+    sparse->isActive = false;
+    sparse->sinceCheck = 0;
+}
+
+/**
+ * Adds the cell at index to the candidates, unless it is one already.
+ */
+static inline void addCandidate(SparseEngine *sparse, long index)
+{
+    uint64_t bit = 1ULL << (index & 63);
+    if ((sparse->marks[index >> 6] & bit) == 0)
+    {
+        sparse->marks[index >> 6] |= bit;
+        sparse->candidates[sparse->nCandidates++] = index;
+    }
+}
+
+/**
+ * Computes the next world of worlds, with the invasion inv landing in it (NULL if there is none), if the world is
+ * sparse, adding the deaths due to fighting to *deathToll. Every SPARSE_CHECK_INTERVAL generations that the dense
+ * engine computes, this checks whether the world has become sparse.
+ *
+ * Returns true if it computed the generation, and false if the dense engine has to; tiles is then up to date. Either
+ * way, the worlds are swapped after it as usual.
+ */
+bool nextSparseState(SparseEngine *sparse, WorldBuffers *worlds, const InvasionPlan *inv, TileMap *tiles, int *deathToll)
+{
+    if (!sparse->isActive)
+    {
+        if (++sparse->sinceCheck < SPARSE_CHECK_INTERVAL)
+        {
+            return false;
+        }
+        sparse->sinceCheck = 0;
+        if (!enterSparse(sparse, worlds))
+        {
+            return false;
+        }
+    }
+
+    int nRows = sparse->nRows;
+    int nCols = sparse->nCols;
+    long nCells = (long)nRows * nCols;
+
+    // an invasion may land more cells than there is room for
+    if (inv != NULL && inv->nInvaders > sparse->capacity - 9 * sparse->nLive)
+    {
+        leaveSparse(sparse, tiles, worlds->curr);
+        return false;
+    }
+
+    sparse->nCandidates = 0;
+    for (long i = 0; i < sparse->nLive; i++)
+    {
+        int row = sparse->live[i] / nCols;
+        int col = sparse->live[i] % nCols;
+        for (int r = row - 1; r <= row + 1; r++)
+        {
+            for (int c = col - 1; c <= col + 1; c++)
+            {
+                if (r >= 0 && r < nRows && c >= 0 && c < nCols)
+                {
+                    addCandidate(sparse, (long)r * nCols + c);
+                }
+            }
+        }
+    }
+
+    // the next world still holds the one before the current one
+    for (long i = 0; i < sparse->nLastLive; i++)
+    {
+        setPaddedValueAt(worlds->next, sparse->lastLive[i] / nCols, sparse->lastLive[i] % nCols, DEAD_FACTION);
+    }
+
+    long nNextLive = 0;
+    uint64_t hash = 0;
+    int deaths = 0;
+    for (long i = 0; i < sparse->nCandidates; i++)
+    {
+        long index = sparse->candidates[i];
+        int row = index / nCols;
+        int col = index % nCols;
+        bool diedDueToFighting;
+        int nextState = getNextState(worlds->curr, row, col, &diedDueToFighting);
+        deaths += diedDueToFighting;
+        setPaddedValueAt(worlds->next, row, col, nextState);
+        if (nextState != DEAD_FACTION)
+        {
+            sparse->lastLive[nNextLive++] = index;
+            hash += hashCell(index, nextState);
+        }
+        sparse->marks[index >> 6] = 0;
+    }
+
+    // the invaders land on top; a cell that is not a candidate is dead in the next world too
+    for (long i = 0; inv != NULL && i < inv->nInvaders; i++)
+    {
+        const Invader *invader = &inv->invaders[i];
+        long index = (long)invader->row * nCols + invader->col;
+        int nextState = getPaddedValueAt(worlds->next, invader->row, invader->col);
+        if (nextState != DEAD_FACTION)
+        {
+            hash -= hashCell(index, nextState);
+        }
+        else
+        {
+            sparse->lastLive[nNextLive++] = index;
+        }
+        deaths += landInvader(worlds->curr, worlds->next, invader->row, invader->col, invader->faction);
+        hash += hashCell(index, invader->faction);
+    }
+    *deathToll += deaths;
+
+    // the next world becomes the current one, and the current one the one before it
+    long *live = sparse->live;
+    sparse->live = sparse->lastLive;
+    sparse->lastLive = live;
+    sparse->nLastLive = sparse->nLive;
+    sparse->nLive = nNextLive;
+    sparse->hash = hash;
+
+    if (nNextLive > nCells / SPARSE_LEAVE_CELLS_PER_LIVE)
+    {
+        leaveSparse(sparse, tiles, worlds->next);
+    }
+    return true;
+}
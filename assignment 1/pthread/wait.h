@@ -0,0 +1,59 @@
+#ifndef WAIT_H
+#define WAIT_H
+
+#include <stdbool.h>
+#include <pthread.h>
+
+/**
+ * How a thread waits for other threads, e.g. for work or at the end of a generation.
+ *
+ * Parking (sleeping on a condition variable) frees the core but takes a futex call to sleep and another to be
+ * woken up, which can cost more than a whole generation of a small world. Spinning answers within nanoseconds
+ * but keeps the core busy.
+ */
+typedef enum WaitPolicy {
+    // park right away
+    WAIT_PARK,
+    // spin with pause, then yield, and never park
+    WAIT_SPIN,
+    // spin with pause for a while, then yield for a while, then park
+    WAIT_ADAPTIVE
+} WaitPolicy;
+
+// rounds of pause, then of sched_yield, before an adaptive waiter parks
+#define WAIT_SPIN_ROUNDS 2000
+#define WAIT_YIELD_ROUNDS 64
+
+/**
+ * Where a waiter is in its policy. Set up with initBackoff every time a thread starts waiting.
+ */
+typedef struct Backoff {
+    WaitPolicy policy;
+    int rounds;
+} Backoff;
+
+/**
+ * A barrier for a fixed number of threads that waits by a WaitPolicy.
+ *
+ * generation is bumped by the last thread to arrive; the others wait for it to change, so the barrier can be reused
+ * right away. Parked threads are only woken up, under lock, if there are any.
+ */
+typedef struct Barrier {
+    unsigned int nThreads;
+    unsigned int arrived;
+    unsigned int generation;
+    unsigned int sleepers;
+    WaitPolicy policy;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+} Barrier;
+
+WaitPolicy getWaitPolicy(void);
+const char *getWaitPolicyName(WaitPolicy policy);
+void initBackoff(Backoff *backoff, WaitPolicy policy);
+bool backoff(Backoff *backoff);
+int initBarrier(Barrier *barrier, unsigned int nThreads, WaitPolicy policy);
+void waitBarrier(Barrier *barrier);
+void destroyBarrier(Barrier *barrier);
+
+#endif
@@ -1,6 +1,11 @@
+import os
 import subprocess
 import sys
 
+# samples that only test something when run on at least this many threads
+# (8 skips cycles that the death toll of every thread must be counted in)
+MIN_THREADS = {8: 4}
+
 def compile(wDir: str):
     print("*** Compiling ***")
     print("running make clean, output: ", end="")
@@ -15,13 +20,15 @@ def compile(wDir: str):
 
 def run(wDir: str, nThreads: int):
     print("*** Running ***")
-    for i in range(7):
+    nSamples = len(os.listdir("{wDir}/sample_inputs".format(wDir=wDir)))
+    for i in range(nSamples):
         program = "./goi.out"
         inp = "sample_inputs/sample{i}.in".format(i=i)
         out = "death_toll.out"
+        sampleThreads = str(max(int(nThreads), MIN_THREADS.get(i, 1)))
          
-        print("Running: {program} {inp} {out} {nThreads}".format(program=program, inp=inp, out=out, nThreads=nThreads))
-        result = subprocess.run([program, inp, out, nThreads], cwd=wDir, capture_output=True)
+        print("Running: {program} {inp} {out} {nThreads}".format(program=program, inp=inp, out=out, nThreads=sampleThreads))
+        result = subprocess.run([program, inp, out, sampleThreads], cwd=wDir, capture_output=True)
         if (len(result.stderr) == 0):
             print("Output: {output}".format(output=result.stdout.decode()))
         else:
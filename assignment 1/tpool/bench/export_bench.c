@@ -0,0 +1,79 @@
+/** \file
+ * Measures how fast worlds are exported when their rows are formatted on one
+ * thread and on several.
+ *
+ * Like goi with EXPORT_GENERATIONS, it exports a big world several times, and
+ * waits for every one of them to be written. The worlds go to /dev/null unless
+ * another path is given, so that only formatting them is measured.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "exporter.h"
+
+#define N_ROWS 4000
+#define N_COLS 4000
+#define N_WORLDS 8
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Returns the seconds it takes to export world N_WORLDS times with nThreads threads formatting it.
+ */
+static double exportRound(const cell_t *world, int nThreads, const char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing. Aborting...\n", path);
+        exit(1);
+    }
+
+    setExportThreads(nThreads);
+    initWorldExporter(file);
+    double start = now();
+    for (int i = 0; i < N_WORLDS; i++)
+    {
+        exportWorld(world, N_ROWS, N_COLS);
+    }
+    closeWorldExporter();
+    double elapsed = now() - start;
+    fclose(file);
+    return elapsed;
+}
+
+int main(int argc, char *argv[])
+{
+    int nThreads = argc > 1 ? atoi(argv[1]) : 1;
+    const char *path = argc > 2 ? argv[2] : "/dev/null";
+
+    // a third of the cells are alive, in 4 factions
+    cell_t *world = malloc(sizeof(cell_t) * N_ROWS * N_COLS);
+    if (world == NULL)
+    {
+        fprintf(stderr, "Failed to allocate the world. Aborting...\n");
+        return 1;
+    }
+    srand(1);
+    for (long i = 0; i < (long)N_ROWS * N_COLS; i++)
+    {
+        world[i] = rand() % 3 == 0 ? 1 + rand() % 4 : DEAD_FACTION;
+    }
+
+    // every cell is one digit: the key, then each row's cells and commas in brackets, and the commas between rows
+    double lineMB = (10 + N_ROWS * (2.0 * N_COLS + 1) + N_ROWS - 1 + 3) / 1e6;
+    double single = exportRound(world, 1, path);
+    double multi = exportRound(world, nThreads, path);
+    printf("%dx%d world: 1 thread %.1f ms (%.0f MB/s), %d threads %.1f ms (%.0f MB/s), %.2fx\n", N_ROWS, N_COLS,
+           single / N_WORLDS * 1e3, lineMB * N_WORLDS / single, nThreads, multi / N_WORLDS * 1e3, lineMB * N_WORLDS / multi,
+           single / multi);
+
+    free(world);
+    return 0;
+}
@@ -0,0 +1,134 @@
+/** \file
+ * Measures the fork-join latency of the pool and of a generation barrier under
+ * every wait policy.
+ *
+ * Like a generation of a small world, every round hands out a few tiny chunks
+ * of work and waits for all of them, so nearly all of its time goes into
+ * waking threads up and waiting for them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "pthread_pool.h"
+#include "wait.h"
+
+typedef struct BarrierArgs {
+    Barrier *barrier;
+    int nRounds;
+} BarrierArgs;
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Stands in for a tile or two of a generation.
+ */
+static void tinyBody(void *ctx, long begin, long end)
+{
+    unsigned long *sums = (unsigned long *)ctx;
+    for (long i = begin; i < end; i++)
+    {
+        sums[i * 8] += i;
+    }
+}
+
+static void *barrierThread(void *args)
+{
+    BarrierArgs *bArgs = (BarrierArgs *)args;
+    for (int round = 0; round < bArgs->nRounds; round++)
+    {
+        waitBarrier(bArgs->barrier);
+        waitBarrier(bArgs->barrier);
+    }
+    return NULL;
+}
+
+/**
+ * Returns the seconds per round of a parallel range with one chunk per thread.
+ */
+static double poolRound(int nThreads, int nRounds, WaitPolicy policy, unsigned long *sums)
+{
+    void *pool = pool_start(NULL, nThreads);
+    pool_set_wait_policy(pool, policy);
+    double start = now();
+    for (int round = 0; round < nRounds; round++)
+    {
+        pool_parallel_for(pool, 0, nThreads + 1, 1, tinyBody, sums);
+    }
+    double elapsed = now() - start;
+    pool_end(pool);
+    return elapsed / nRounds;
+}
+
+/**
+ * Returns the seconds per round of releasing nThreads - 1 threads at a barrier and waiting for them at another, as
+ * the pthread backend does every generation.
+ */
+static double barrierRound(int nThreads, int nRounds, WaitPolicy policy)
+{
+    Barrier barrier;
+    if (initBarrier(&barrier, nThreads, policy) != 0)
+    {
+        fprintf(stderr, "Failed to initialise barrier. Aborting...\n");
+        exit(1);
+    }
+    BarrierArgs bArgs = {&barrier, nRounds};
+    pthread_t threads[nThreads];
+    for (int t = 1; t < nThreads; t++)
+    {
+        pthread_create(&threads[t], NULL, barrierThread, &bArgs);
+    }
+    double start = now();
+    for (int round = 0; round < nRounds; round++)
+    {
+        waitBarrier(&barrier);
+        waitBarrier(&barrier);
+    }
+    double elapsed = now() - start;
+    for (int t = 1; t < nThreads; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    destroyBarrier(&barrier);
+    return elapsed / nRounds;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <NUM_THREADS> [<ROUNDS>]\n", argv[0]);
+        return 1;
+    }
+    int nThreads = atoi(argv[1]);
+    int nRounds = argc > 2 ? atoi(argv[2]) : 20000;
+    if (nThreads <= 0 || nRounds <= 0)
+    {
+        fprintf(stderr, "Every argument must be positive. Aborting...\n");
+        return 1;
+    }
+
+    // a cache line per index, so chunks do not share lines
+    unsigned long *sums = calloc((nThreads + 1) * 8, sizeof(unsigned long));
+    if (sums == NULL)
+    {
+        fprintf(stderr, "No memory for sums. Aborting...\n");
+        return 1;
+    }
+
+    for (int policy = WAIT_PARK; policy <= WAIT_ADAPTIVE; policy++)
+    {
+        double pool = poolRound(nThreads, nRounds, policy, sums);
+        double barrier = barrierRound(nThreads, nRounds, policy);
+        printf("threads: %d, policy: %-8s pool fork-join: %8.2fus, barrier round: %8.2fus\n", nThreads, getWaitPolicyName(policy), pool * 1e6, barrier * 1e6);
+    }
+
+    free(sums);
+    return 0;
+}
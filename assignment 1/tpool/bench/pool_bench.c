@@ -0,0 +1,91 @@
+/** \file
+ * Measures the task throughput of a pthread pool.
+ *
+ * Like goi, it runs rounds of many small tasks: every round enqueues all of
+ * them and then waits for the pool to finish them. Link it with the pool to
+ * measure (see the bench target of the Makefile).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "pthread_pool.h"
+
+typedef struct BenchTask {
+    long work;
+    unsigned long result;
+} BenchTask;
+
+/**
+ * Burns roughly work iterations of arithmetic, standing in for a few rows of a generation.
+ */
+void *benchTask(void *args)
+{
+    BenchTask *task = (BenchTask *)args;
+    unsigned long x = (unsigned long)task->work;
+    for (long i = 0; i < task->work; i++)
+    {
+        x = x * 6364136223846793005UL + 1442695040888963407UL;
+    }
+    task->result = x;
+    return NULL;
+}
+
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <NUM_THREADS> [<TASKS_PER_ROUND> <ROUNDS> <WORK_PER_TASK>]\n", argv[0]);
+        return 1;
+    }
+    int nThreads = atoi(argv[1]);
+    int nTasks = argc > 2 ? atoi(argv[2]) : 1000;
+    int nRounds = argc > 3 ? atoi(argv[3]) : 200;
+    long work = argc > 4 ? atol(argv[4]) : 2000;
+    if (nThreads <= 0 || nTasks <= 0 || nRounds <= 0 || work < 0)
+    {
+        fprintf(stderr, "Every argument must be positive. Aborting...\n");
+        return 1;
+    }
+
+    BenchTask *tasks = malloc(sizeof(BenchTask) * nTasks);
+    if (tasks == NULL)
+    {
+        fprintf(stderr, "No memory for tasks. Aborting...\n");
+        return 1;
+    }
+    for (int i = 0; i < nTasks; i++)
+    {
+        tasks[i].work = work;
+    }
+
+    void *pool = pool_start(benchTask, nThreads);
+    double start = now();
+    for (int round = 0; round < nRounds; round++)
+    {
+        for (int i = 0; i < nTasks; i++)
+        {
+            pool_enqueue(pool, &tasks[i], 0);
+        }
+        pool_wait(pool);
+    }
+    double elapsed = now() - start;
+    pool_end(pool);
+
+    unsigned long checksum = 0;
+    for (int i = 0; i < nTasks; i++)
+    {
+        checksum += tasks[i].result;
+    }
+    printf("%s threads: %d, tasks: %ld, time: %.3fs, tasks/s: %.0f (checksum %lx)\n", argv[0], nThreads, (long)nTasks * nRounds, elapsed, nTasks * (double)nRounds / elapsed, checksum);
+
+    free(tasks);
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include "pthread_pool.h"
+#include <pthread.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define CACHE_LINE_SIZE 64
+#define DEQUE_INITIAL_CAPACITY 64
+
+struct pool_task {
+	void *arg;
+	char free;
+};
+
+/*
+ * The circular buffer of a deque. capacity is a power of 2. When a deque
+ * outgrows its buffer, the old one is kept on the retired list until
+ * pool_end, since a thief may still be reading from it.
+ */
+struct deque_array {
+	long capacity;
+	struct deque_array *retired;
+	struct pool_task tasks[];
+};
+
+/*
+ * A Chase-Lev work-stealing deque (Chase and Lev, SPAA 2005, with the C11
+ * orderings of Le et al., PPoPP 2013).
+ *
+ * Tasks are pushed at bottom and taken from top with a CAS, so the workers
+ * taking tasks never lock. Every task enters the pool through pool_enqueue,
+ * which is the only place that pushes; its submit lock keeps bottom
+ * single-writer even if several threads enqueue at once. Taking from top
+ * means each deque hands out its tasks in the order they were enqueued.
+ *
+ * top and bottom are on their own cache lines, since the thieves hammer top.
+ */
+struct deque {
+	long top __attribute__((aligned(CACHE_LINE_SIZE)));
+	long bottom __attribute__((aligned(CACHE_LINE_SIZE)));
+	struct deque_array *array;
+};
+
+struct worker {
+	struct pool *pool;
+	unsigned int index;
+	pthread_t thread;
+	struct deque deque;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct pool {
+	char cancelled;
+	void *(*fn)(void *);
+	unsigned int remaining;
+	unsigned int nthreads;
+	/* the deque the next enqueued task goes to; guarded by submit_mtx */
+	unsigned int next;
+	/* the number of workers parked on work_cnd */
+	unsigned int sleepers;
+	struct worker *workers;
+	pthread_mutex_t submit_mtx;
+	/* guards parking: workers wait on work_cnd, pool_wait on done_cnd */
+	pthread_mutex_t q_mtx;
+	pthread_cond_t work_cnd;
+	pthread_cond_t done_cnd;
+};
+
+static void * thread(void *arg);
+
+static struct deque_array * deque_array_new(long capacity) {
+	struct deque_array *a = (struct deque_array *) malloc(sizeof(struct deque_array) + capacity * sizeof(struct pool_task));
+	a->capacity = capacity;
+	a->retired = NULL;
+	return a;
+}
+
+static void deque_init(struct deque *d) {
+	d->top = 0;
+	d->bottom = 0;
+	d->array = deque_array_new(DEQUE_INITIAL_CAPACITY);
+}
+
+/*
+ * Doubles the buffer of d, which holds the tasks [t, b).
+ */
+static struct deque_array * deque_grow(struct deque *d, struct deque_array *a, long t, long b) {
+	struct deque_array *bigger = deque_array_new(a->capacity * 2);
+	long i;
+
+	for (i = t; i < b; i++) {
+		bigger->tasks[i & (bigger->capacity - 1)] = a->tasks[i & (a->capacity - 1)];
+	}
+	bigger->retired = a;
+	__atomic_store_n(&d->array, bigger, __ATOMIC_RELEASE);
+	return bigger;
+}
+
+static void deque_push(struct deque *d, void *arg, char free) {
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	struct deque_array *a = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+	struct pool_task *slot;
+
+	if (b - t >= a->capacity) {
+		a = deque_grow(d, a, t, b);
+	}
+	slot = &a->tasks[b & (a->capacity - 1)];
+	__atomic_store_n(&slot->arg, arg, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->free, free, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Takes the task at the top of d into *task.
+ *
+ * Returns 1 if a task was taken, 0 if d is empty and -1 if another thread
+ * took the top task first (d may still have more).
+ */
+static int deque_steal(struct deque *d, struct pool_task *task) {
+	long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+	struct deque_array *a;
+	struct pool_task *slot;
+
+	if (t >= b) {
+		return 0;
+	}
+	a = __atomic_load_n(&d->array, __ATOMIC_ACQUIRE);
+	slot = &a->tasks[t & (a->capacity - 1)];
+	task->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+	task->free = __atomic_load_n(&slot->free, __ATOMIC_RELAXED);
+	if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		return -1;
+	}
+	return 1;
+}
+
+static int deque_empty(struct deque *d) {
+	long t = __atomic_load_n(&d->top, __ATOMIC_SEQ_CST);
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST);
+	return t >= b;
+}
+
+/*
+ * Frees the tasks left in d (their args too, if they asked for it) and
+ * every buffer d has used. No other thread may touch d any more.
+ */
+static void deque_destroy(struct deque *d) {
+	struct deque_array *a = d->array;
+	struct deque_array *retired;
+	long i;
+
+	for (i = d->top; i < d->bottom; i++) {
+		if (a->tasks[i & (a->capacity - 1)].free) free(a->tasks[i & (a->capacity - 1)].arg);
+	}
+	while (a != NULL) {
+		retired = a->retired;
+		free(a);
+		a = retired;
+	}
+}
+
+void * pool_start(void * (*thread_func)(void *), unsigned int threads) {
+	struct pool *p = (struct pool *) malloc(sizeof(struct pool));
+	int i;
+
+	pthread_mutex_init(&p->submit_mtx, NULL);
+	pthread_mutex_init(&p->q_mtx, NULL);
+	pthread_cond_init(&p->work_cnd, NULL);
+	pthread_cond_init(&p->done_cnd, NULL);
+	p->nthreads = threads;
+	p->fn = thread_func;
+	p->cancelled = 0;
+	p->remaining = 0;
+	p->next = 0;
+	p->sleepers = 0;
+
+	if (posix_memalign((void **) &p->workers, CACHE_LINE_SIZE, threads * sizeof(struct worker)) != 0) {
+		fprintf(stderr, "Failed to mem alloc for pool workers\n");
+		exit(1);
+	}
+	for (i = 0; i < threads; i++) {
+		p->workers[i].pool = p;
+		p->workers[i].index = i;
+		deque_init(&p->workers[i].deque);
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_create(&p->workers[i].thread, NULL, &thread, &p->workers[i]);
+	}
+
+	return p;
+}
+
+/*
+ * Tasks are dealt to the workers' deques round-robin; a worker that runs
+ * out steals from the others.
+ */
+void pool_enqueue(void *pool, void *arg, char free) {
+	struct pool *p = (struct pool *) pool;
+
+	/* count the task before anyone can run it, so remaining never underflows */
+	__atomic_add_fetch(&p->remaining, 1, __ATOMIC_SEQ_CST);
+
+	pthread_mutex_lock(&p->submit_mtx);
+	deque_push(&p->workers[p->next].deque, arg, free);
+	p->next = (p->next + 1) % p->nthreads;
+	pthread_mutex_unlock(&p->submit_mtx);
+
+	/* pairs with the sleepers increment in park: either a parking worker sees the task, or we see it parking */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&p->sleepers, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&p->q_mtx);
+		pthread_cond_signal(&p->work_cnd);
+		pthread_mutex_unlock(&p->q_mtx);
+	}
+}
+
+void pool_wait(void *pool) {
+	struct pool *p = (struct pool *) pool;
+
+	pthread_mutex_lock(&p->q_mtx);
+	while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE) && __atomic_load_n(&p->remaining, __ATOMIC_ACQUIRE)) {
+		pthread_cond_wait(&p->done_cnd, &p->q_mtx);
+	}
+	pthread_mutex_unlock(&p->q_mtx);
+}
+
+void pool_end(void *pool) {
+	struct pool *p = (struct pool *) pool;
+	int i;
+
+	__atomic_store_n(&p->cancelled, 1, __ATOMIC_RELEASE);
+
+	pthread_mutex_lock(&p->q_mtx);
+	pthread_cond_broadcast(&p->work_cnd);
+	pthread_cond_broadcast(&p->done_cnd);
+	pthread_mutex_unlock(&p->q_mtx);
+
+	for (i = 0; i < p->nthreads; i++) {
+		pthread_join(p->workers[i].thread, NULL);
+	}
+
+	for (i = 0; i < p->nthreads; i++) {
+		deque_destroy(&p->workers[i].deque);
+	}
+
+	pthread_mutex_destroy(&p->submit_mtx);
+	pthread_mutex_destroy(&p->q_mtx);
+	pthread_cond_destroy(&p->work_cnd);
+	pthread_cond_destroy(&p->done_cnd);
+	free(p->workers);
+	free(p);
+}
+
+/*
+ * Takes a task for worker self into *task: from its own deque first, then
+ * by stealing from the others, starting with its neighbour.
+ *
+ * Returns 0 if every deque was empty.
+ */
+static int take(struct pool *p, unsigned int self, struct pool_task *task) {
+	unsigned int i, victim;
+	int got;
+
+	for (i = 0; i < p->nthreads; i++) {
+		victim = (self + i) % p->nthreads;
+		do {
+			got = deque_steal(&p->workers[victim].deque, task);
+		} while (got < 0);
+		if (got) return 1;
+	}
+	return 0;
+}
+
+static int has_work(struct pool *p) {
+	unsigned int i;
+
+	for (i = 0; i < p->nthreads; i++) {
+		if (!deque_empty(&p->workers[i].deque)) return 1;
+	}
+	return 0;
+}
+
+/*
+ * Sleeps until there may be a task to take or the pool is cancelled.
+ */
+static void park(struct pool *p) {
+	pthread_mutex_lock(&p->q_mtx);
+	__atomic_add_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+	while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE) && !has_work(p)) {
+		pthread_cond_wait(&p->work_cnd, &p->q_mtx);
+	}
+	__atomic_sub_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&p->q_mtx);
+}
+
+static void * thread(void *arg) {
+	struct worker *w = (struct worker *) arg;
+	struct pool *p = w->pool;
+	struct pool_task task;
+
+	while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE)) {
+		if (!take(p, w->index, &task)) {
+			park(p);
+			continue;
+		}
+
+		p->fn(task.arg);
+
+		if (task.free) free(task.arg);
+
+		if (__atomic_sub_fetch(&p->remaining, 1, __ATOMIC_ACQ_REL) == 0) {
+			pthread_mutex_lock(&p->q_mtx);
+			pthread_cond_broadcast(&p->done_cnd);
+			pthread_mutex_unlock(&p->q_mtx);
+		}
+	}
+
+	return NULL;
+}
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "input.h"
+
+/**
+ * Converts a GOI input file to the binary format (see input.h), which goi.out maps instead of parsing.
+ *
+ * The input is read exactly as goi.out reads it, so a file it rejects is rejected here too, and every cell that
+ * ends up in the binary file is a valid faction.
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <INPUT_PATH> <BINARY_OUTPUT_PATH>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *inputFile = fopen(argv[1], "r");
+    if (inputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for reading. Aborting...\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+
+    // parse it on every CPU
+    GoiInput input;
+    if (readInput(inputFile, (int)sysconf(_SC_NPROCESSORS_ONLN), &input) == -1)
+    {
+        exit(EXIT_FAILURE);
+    }
+    fclose(inputFile);
+
+    FILE *outputFile = fopen(argv[2], "wb");
+    if (outputFile == NULL)
+    {
+        fprintf(stderr, "Failed to open %s for writing. Aborting...\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+    if (writeBinaryInput(outputFile, &input) == -1 || fclose(outputFile) != 0)
+    {
+        fprintf(stderr, "Failed to write %s. Aborting...\n", argv[2]);
+        exit(EXIT_FAILURE);
+    }
+
+    freeInput(&input);
+}
@@ -6,9 +6,21 @@
  * Usage:
  *  1) Call initWorldExporter once with an open file with write permissions.
  *  2) Call exportWorld whenever you wish to write a world state to the file specified in step 1.
+ *  3) Call closeWorldExporter once done, before closing the file.
+ *
+ * Worlds are written by a writer thread of their own: exportWorld only copies the world into a ring of
+ * EXPORT_RING_SIZE snapshots and returns, and the writer formats and writes the snapshots in the order they were
+ * handed over. If the writer falls behind so far that the ring is full, exportWorld waits for it to free a snapshot.
+ *
+ * A big world is formatted by up to setExportThreads threads at once, each formatting a range of its rows into a
+ * buffer of its own; the buffers are then written in row order, so the line is the same as if one thread had
+ * formatted it. The writer starts the threads that help it format once, and wakes them for every big world.
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <pthread.h>
 #include "exporter.h"
 #include "sb/sb.h"
 #include "util.h"
@@ -17,73 +29,432 @@
 
 FILE *exportFile = NULL;
 
+// how many threads may format a world
+static int exportThreads = 1;
+
+/**
+ * A world handed over to the writer. Its cells are kept from one world to the next of the same size.
+ */
+typedef struct Snapshot {
+    cell_t *cells;
+    long capacity;
+    int nRows;
+    int nCols;
+} Snapshot;
+
+/**
+ * The writer and the ring of snapshots it writes.
+ */
+static struct {
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    // the nth world handed over is in ring[n % EXPORT_RING_SIZE] until it has been written
+    Snapshot ring[EXPORT_RING_SIZE];
+    long nQueued;
+    long nWritten;
+    bool isRunning;
+    bool isClosing;
+} exporter;
+
+struct Formatters;
+
+/**
+ * The rows [rowStart, rowEnd) of a world, to be formatted into sb by a thread of their own.
+ */
+typedef struct RowRange {
+    const cell_t *world;
+    int nRows;
+    int nCols;
+    int rowStart;
+    int rowEnd;
+    // kept from one world to the next
+    StringBuilder *sb;
+    struct Formatters *formatters;
+    pthread_t thread;
+} RowRange;
+
+/**
+ * The threads that format a world along with the writer: ranges[0] is formatted by the writer, and ranges[r] by
+ * formatter r, for r up to nFormatters. They are started once, and every thread waits at barrier once before and
+ * once after each world that is split.
+ */
+typedef struct Formatters {
+    RowRange *ranges;
+    // how many ranges there are room for
+    int maxRanges;
+    int nFormatters;
+    // how many ranges the world being formatted is split into
+    int nRanges;
+    bool isClosing;
+    pthread_barrier_t barrier;
+    // held while the formatters are started, so that none waits at barrier before it is set up
+    pthread_mutex_t startLock;
+} Formatters;
+
+static int startFormatters(Formatters *formatters, int maxRanges);
+static void stopFormatters(Formatters *formatters);
+static void writeWorld(Formatters *formatters, const cell_t *world, int nRows, int nCols);
+
+static void freeRowRanges(RowRange *ranges, int nRanges)
+{
+    for (int r = 0; ranges != NULL && r < nRanges; r++)
+    {
+        if (ranges[r].sb != NULL)
+        {
+            sb_free(ranges[r].sb);
+        }
+    }
+    free(ranges);
+}
+
+/**
+ * Allocates nRanges row ranges, each with a string builder of its own.
+ *
+ * NULL is returned if there is no memory.
+ */
+static RowRange *allocRowRanges(int nRanges)
+{
+    RowRange *ranges = calloc(nRanges, sizeof(RowRange));
+    for (int r = 0; ranges != NULL && r < nRanges; r++)
+    {
+        if ((ranges[r].sb = sb_create()) == NULL)
+        {
+            freeRowRanges(ranges, nRanges);
+            return NULL;
+        }
+    }
+    return ranges;
+}
+
+/**
+ * Writes the snapshots of the ring as they are handed over, until the exporter is closing and all of them have been
+ * written.
+ */
+static void *writeSnapshots(void *args)
+{
+    (void)args;
+    Formatters formatters;
+    bool hasFormatters = startFormatters(&formatters, exportThreads) == 0;
+    if (!hasFormatters)
+    {
+        fprintf(stderr, "Error: out of memory!\n");
+    }
+
+    pthread_mutex_lock(&exporter.lock);
+    for (;;)
+    {
+        while (exporter.nWritten == exporter.nQueued && !exporter.isClosing)
+        {
+            pthread_cond_wait(&exporter.changed, &exporter.lock);
+        }
+        if (exporter.nWritten == exporter.nQueued)
+        {
+            break;
+        }
+
+        // the snapshot is not touched by exportWorld until it has been written
+        Snapshot *snapshot = &exporter.ring[exporter.nWritten % EXPORT_RING_SIZE];
+        pthread_mutex_unlock(&exporter.lock);
+        if (hasFormatters)
+        {
+            writeWorld(&formatters, snapshot->cells, snapshot->nRows, snapshot->nCols);
+        }
+        pthread_mutex_lock(&exporter.lock);
+
+        exporter.nWritten++;
+        pthread_cond_broadcast(&exporter.changed);
+    }
+    pthread_mutex_unlock(&exporter.lock);
+
+    if (hasFormatters)
+    {
+        stopFormatters(&formatters);
+    }
+    return NULL;
+}
+
 /**
  * Initializes the world exporter with the input file.
  * 
  * If input file is NULL or initWorldExporter has not been called, then calls to exportWorld
  * will do nothing.
  * 
- * Otherwise, subsequent calls to exportWorld will export to the input file.
+ * Otherwise, subsequent calls to exportWorld will export to the input file, through a writer thread that is started
+ * here. If it cannot be started, exportWorld writes the worlds itself.
  */
 void initWorldExporter(FILE *file) {
     exportFile = file;
+    if (exportFile == NULL)
+    {
+        return;
+    }
+
+    pthread_mutex_init(&exporter.lock, NULL);
+    pthread_cond_init(&exporter.changed, NULL);
+    exporter.isRunning = pthread_create(&exporter.writer, NULL, writeSnapshots, NULL) == 0;
+}
+
+/**
+ * Lets up to nThreads threads format each world. Only takes effect from the next call to initWorldExporter.
+ */
+void setExportThreads(int nThreads)
+{
+    exportThreads = nThreads > 1 ? nThreads : 1;
 }
 
 /**
  * Exports the input world.
  * 
- * Requires that initWorldExporter be called prior with a valid file.
+ * Requires that initWorldExporter be called prior with a valid file. The world is copied, so it can be changed as soon
+ * as this returns, but it is only written to the file by the writer thread later on.
  */
-void exportWorld(const int *world, int nRows, int nCols)
+void exportWorld(const cell_t *world, int nRows, int nCols)
 {
     if (exportFile == NULL)
     {
         return;
     }
+    if (!exporter.isRunning)
+    {
+        Formatters formatters;
+        if (startFormatters(&formatters, 1) != 0)
+        {
+            fprintf(stderr, "Error: out of memory!\n");
+            return;
+        }
+        writeWorld(&formatters, world, nRows, nCols);
+        stopFormatters(&formatters);
+        return;
+    }
 
-    StringBuilder *sb = sb_create();
-    if (sb == NULL)
+    // wait for a snapshot to be free if the writer has fallen behind
+    pthread_mutex_lock(&exporter.lock);
+    while (exporter.nQueued - exporter.nWritten == EXPORT_RING_SIZE)
+    {
+        pthread_cond_wait(&exporter.changed, &exporter.lock);
+    }
+    Snapshot *snapshot = &exporter.ring[exporter.nQueued % EXPORT_RING_SIZE];
+    pthread_mutex_unlock(&exporter.lock);
+
+    long nCells = (long)nRows * nCols;
+    if (nCells > snapshot->capacity)
+    {
+        cell_t *cells = realloc(snapshot->cells, sizeof(cell_t) * nCells);
+        if (cells == NULL)
+        {
+            fprintf(stderr, "Error: out of memory!\n");
+            return;
+        }
+        snapshot->cells = cells;
+        snapshot->capacity = nCells;
+    }
+    memcpy(snapshot->cells, world, sizeof(cell_t) * nCells);
+    snapshot->nRows = nRows;
+    snapshot->nCols = nCols;
+
+    pthread_mutex_lock(&exporter.lock);
+    exporter.nQueued++;
+    pthread_cond_broadcast(&exporter.changed);
+    pthread_mutex_unlock(&exporter.lock);
+}
+
+/**
+ * Waits for every world exported so far to be written, in order, then stops the writer thread.
+ *
+ * Does nothing if initWorldExporter was not called with a valid file. The file itself is left open.
+ */
+void closeWorldExporter(void)
+{
+    if (exportFile == NULL || !exporter.isRunning)
     {
-        fprintf(stderr, "Error: out of memory!\n");
         return;
     }
 
-    sb_append(sb, "{");
-    sb_append(sb, JSON_KEY);
-    sb_append(sb, ":[");
-    for (int row = 0; row < nRows; row++)
+    pthread_mutex_lock(&exporter.lock);
+    exporter.isClosing = true;
+    pthread_cond_broadcast(&exporter.changed);
+    pthread_mutex_unlock(&exporter.lock);
+    pthread_join(exporter.writer, NULL);
+
+    for (int i = 0; i < EXPORT_RING_SIZE; i++)
     {
-        sb_append(sb, "[");
+        free(exporter.ring[i].cells);
+    }
+    pthread_cond_destroy(&exporter.changed);
+    pthread_mutex_destroy(&exporter.lock);
+    memset(&exporter, 0, sizeof(exporter));
+}
+
+/**
+ * Formats the rows of range into its builder: the part of the line of JSON of the world that they make up, with the
+ * start of the line if they are the first rows and its end if they are the last.
+ */
+static void formatRows(RowRange *range)
+{
+    StringBuilder *sb = range->sb;
+    int nCols = range->nCols;
+
+    sb_reset(sb);
+    if (range->rowStart == 0)
+    {
+        sb_append(sb, "{");
+        sb_append(sb, JSON_KEY);
+        sb_append(sb, ":[");
+    }
+    for (int row = range->rowStart; row < range->rowEnd; row++)
+    {
+        const cell_t *worldRow = range->world + (long)row * nCols;
+        sb_appendc(sb, '[');
         for (int col = 0; col < nCols; col++)
         {
-            sb_appendf(sb, "%d", getValueAt(world, nRows, nCols, row, col));
+            sb_appendint(sb, worldRow[col]);
             if (col != nCols - 1) {
-                sb_append(sb, ",");
+                sb_appendc(sb, ',');
             }
         }
-        sb_append(sb, "]");
-        if (row != nRows - 1) {
-            sb_append(sb, ",");
+        sb_appendc(sb, ']');
+        if (row != range->nRows - 1) {
+            sb_appendc(sb, ',');
         }
     }
-    sb_append(sb, "]}\n");
+    if (range->rowEnd == range->nRows)
+    {
+        sb_append(sb, "]}\n");
+    }
+}
 
-    char *s = sb_concat(sb);
-    if (s == NULL)
+/**
+ * The loop run by every formatter until its formatters stop: wait for the writer to split a world, format the range
+ * of it given to this formatter if there is one, then wait for every other range to be formatted.
+ */
+static void *runFormatter(void *args)
+{
+    RowRange *range = args;
+    Formatters *formatters = range->formatters;
+    int r = range - formatters->ranges;
+
+    pthread_mutex_lock(&formatters->startLock);
+    pthread_mutex_unlock(&formatters->startLock);
+    for (;;)
     {
-        fprintf(stderr, "Error: out of memory!\n");
-        sb_free(sb);
-        return;
+        pthread_barrier_wait(&formatters->barrier);
+        if (formatters->isClosing)
+        {
+            break;
+        }
+        if (r < formatters->nRanges)
+        {
+            formatRows(range);
+        }
+        pthread_barrier_wait(&formatters->barrier);
     }
+    return NULL;
+}
 
-    if (fputs(s, exportFile) == EOF)
+/**
+ * Sets up formatters to split worlds into up to maxRanges ranges, starting a formatter for every range but the first.
+ * If a formatter cannot be started, worlds are split between the ones started before it.
+ *
+ * Returns 0 on success, or -1 if there is no memory.
+ */
+static int startFormatters(Formatters *formatters, int maxRanges)
+{
+    memset(formatters, 0, sizeof(Formatters));
+    formatters->ranges = allocRowRanges(maxRanges);
+    if (formatters->ranges == NULL)
     {
-        fprintf(stderr, "Error: cannot export to file.\n");
-        free(s);
-        sb_free(sb);
-        return;
+        return -1;
+    }
+    formatters->maxRanges = maxRanges;
+
+    pthread_mutex_init(&formatters->startLock, NULL);
+    pthread_mutex_lock(&formatters->startLock);
+    for (int r = 1; r < maxRanges; r++)
+    {
+        formatters->ranges[r].formatters = formatters;
+        if (pthread_create(&formatters->ranges[r].thread, NULL, runFormatter, &formatters->ranges[r]) != 0)
+        {
+            break;
+        }
+        formatters->nFormatters++;
+    }
+    pthread_barrier_init(&formatters->barrier, NULL, formatters->nFormatters + 1);
+    pthread_mutex_unlock(&formatters->startLock);
+    return 0;
+}
+
+/**
+ * Stops the formatters of formatters and frees their ranges.
+ */
+static void stopFormatters(Formatters *formatters)
+{
+    formatters->isClosing = true;
+    pthread_barrier_wait(&formatters->barrier);
+    for (int r = 1; r <= formatters->nFormatters; r++)
+    {
+        pthread_join(formatters->ranges[r].thread, NULL);
+    }
+    pthread_barrier_destroy(&formatters->barrier);
+    pthread_mutex_destroy(&formatters->startLock);
+    freeRowRanges(formatters->ranges, formatters->maxRanges);
+}
+
+/**
+ * Writes world to the export file as one line of JSON. The formatters and the calling thread split it between them,
+ * one of their ranges each, unless it is too small for that to pay off; it is then formatted by the calling thread
+ * alone, without waking the formatters.
+ *
+ * The builders of the ranges are reused from one world to the next, so that once they have grown to fit a world,
+ * formatting the next allocates nothing.
+ */
+static void writeWorld(Formatters *formatters, const cell_t *world, int nRows, int nCols)
+{
+    RowRange *ranges = formatters->ranges;
+    int nRanges = (long)nRows * nCols < EXPORT_PARALLEL_CELLS ? 1 : formatters->nFormatters + 1;
+    if (nRanges > nRows)
+    {
+        nRanges = nRows;
+    }
+
+    for (int r = 0; r < nRanges; r++)
+    {
+        ranges[r].world = world;
+        ranges[r].nRows = nRows;
+        ranges[r].nCols = nCols;
+        ranges[r].rowStart = (long)nRows * r / nRanges;
+        ranges[r].rowEnd = (long)nRows * (r + 1) / nRanges;
+    }
+    if (nRanges == 1)
+    {
+        formatRows(&ranges[0]);
+    }
+    else
+    {
+        // wake the formatters, format the first range, then wait for them to finish theirs
+        formatters->nRanges = nRanges;
+        pthread_barrier_wait(&formatters->barrier);
+        formatRows(&ranges[0]);
+        pthread_barrier_wait(&formatters->barrier);
     }
 
-    free(s);
-    sb_free(sb);
+    // an append that failed makes every later one on its builder fail too
+    for (int r = 0; r < nRanges; r++)
+    {
+        if (ranges[r].sb->failed)
+        {
+            fprintf(stderr, "Error: out of memory!\n");
+            return;
+        }
+    }
+
+    // the line is written straight from the builders, in row order, without copying it out
+    for (int r = 0; r < nRanges; r++)
+    {
+        if (sb_write(ranges[r].sb, exportFile) == SB_FAILURE)
+        {
+            fprintf(stderr, "Error: cannot export to file.\n");
+            return;
+        }
+    }
 }
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "kernel.h"
+
+/**
+ * Specifies the number(s) of live neighbors of the same faction required for a dead cell to become alive.
+ */
+bool isBirthable(int n)
+{
+    return n == 3;
+}
+
+/**
+ * Specifies the number(s) of live neighbors of the same faction required for a live cell to remain alive.
+ */
+bool isSurvivable(int n)
+{
+    return n == 2 || n == 3;
+}
+
+/**
+ * Specifies the number of live neighbors of a different faction required for a live cell to die due to fighting.
+ */
+bool willFight(int n) {
+    return n > 0;
+}
+
+/**
+ * Computes and returns the next state of the cell specified by row and col based on currWorld. Sets *diedDueToFighting to
+ * true if this cell should count towards the death toll due to fighting.
+ * 
+ * Invaders are not taken into account; landInvader lands them afterwards.
+ */
+int getNextState(const PaddedWorld *currWorld, int row, int col, bool *diedDueToFighting)
+{
+    // we'll explicitly set if it was death due to fighting
+    *diedDueToFighting = false;
+
+    // the halo guarantees all 8 neighbours are addressable from here
+    const cell_t *cell = paddedRow(currWorld, row) + col;
+    int stride = currWorld->stride;
+
+    // faction of this cell
+    int cellFaction = *cell;
+
+    // tracks count of each faction adjacent to this cell
+    int neighborCounts[MAX_FACTIONS];
+    memset(neighborCounts, 0, MAX_FACTIONS * sizeof(int));
+
+    // count neighbors (and self)
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        const cell_t *neighborRow = cell + dy * stride;
+        neighborCounts[neighborRow[-1]]++;
+        neighborCounts[neighborRow[0]]++;
+        neighborCounts[neighborRow[1]]++;
+    }
+
+    // we counted this cell as its "neighbor"; adjust for this
+    neighborCounts[cellFaction]--;
+
+    if (cellFaction == DEAD_FACTION)
+    {
+        // this is a dead cell; we need to see if a birth is possible:
+        // need exactly 3 of a single faction; we don't care about other factions
+
+        // by default, no birth
+        int newFaction = DEAD_FACTION;
+
+        // start at 1 because we ignore dead neighbors
+        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+        {
+            int count = neighborCounts[faction];
+            if (isBirthable(count))
+            {
+                newFaction = faction;
+            }
+        }
+
+        return newFaction;
+    }
+    else
+    {
+        /** 
+         * this is a live cell; we follow the usual rules:
+         * Death (fighting): > 0 hostile neighbor
+         * Death (underpopulation): < 2 friendly neighbors and 0 hostile neighbors
+         * Death (overpopulation): > 3 friendly neighbors and 0 hostile neighbors
+         * Survival: 2 or 3 friendly neighbors and 0 hostile neighbors
+         */
+
+        int hostileCount = 0;
+        for (int faction = DEAD_FACTION + 1; faction < MAX_FACTIONS; faction++)
+        {
+            if (faction == cellFaction)
+            {
+                continue;
+            }
+            hostileCount += neighborCounts[faction];
+        }
+
+        if (willFight(hostileCount))
+        {
+            *diedDueToFighting = true;
+            return DEAD_FACTION;
+        }
+
+        int friendlyCount = neighborCounts[cellFaction];
+        if (!isSurvivable(friendlyCount))
+        {
+            return DEAD_FACTION;
+        }
+
+        return cellFaction;
+    }
+}
+
+typedef int (*RowKernel)(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int colStart, int colEnd);
+
+/**
+ * Computes the next state of the cells [colStart, colEnd) of row one cell at a time. Returns the number of those
+ * cells that count towards the death toll due to fighting.
+ */
+static int scalarRowKernel(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int colStart, int colEnd)
+{
+    int deaths = 0;
+    cell_t *newRow = paddedRow(nextWorld, row);
+    for (int col = colStart; col < colEnd; col++)
+    {
+        bool diedDueToFighting;
+        newRow[col] = getNextState(currWorld, row, col, &diedDueToFighting);
+        if (diedDueToFighting)
+        {
+            deaths++;
+        }
+    }
+    return deaths;
+}
+
+// A tally packs one 4-bit count per faction into a word: the count of faction f is in bits [4f, 4f + 4). A
+// window never sums more than 9 cells, so adding or subtracting tallies never carries from one count to the next.
+typedef uint64_t Tally;
+
+// a tally with a count of 1 for every faction
+#define TALLY_ONES ((((Tally)1 << (4 * MAX_FACTIONS)) - 1) / 15)
+
+#define TALLY_COUNT(tally, faction) ((int)(((tally) >> (4 * (faction))) & 0xf))
+
+/**
+ * Returns the tally of the 3 cells of column col in the rows up, mid and down.
+ */
+static inline Tally columnTally(const cell_t *up, const cell_t *mid, const cell_t *down, int col)
+{
+    return ((Tally)1 << (4 * up[col])) + ((Tally)1 << (4 * mid[col])) + ((Tally)1 << (4 * down[col]));
+}
+
+/**
+ * Returns the highest live faction with a count of exactly 3 in tally, or DEAD_FACTION if there is none.
+ */
+static inline int highestTriple(Tally tally)
+{
+    // zero the counts that are 3, then find zero counts: a count is zero iff neither its top bit nor (its low
+    // 3 bits + 7) has bit 3 set
+    Tally x = tally ^ (3 * TALLY_ONES);
+    Tally low = (x & (7 * TALLY_ONES)) + 7 * TALLY_ONES;
+    Tally zeros = ~(low | x | (7 * TALLY_ONES)) & (8 * TALLY_ONES);
+
+    // the dead faction cannot be born
+    zeros &= ~(Tally)0xf;
+    if (zeros == 0)
+    {
+        return DEAD_FACTION;
+    }
+    return (63 - __builtin_clzll(zeros)) / 4;
+}
+
+/**
+ * The same as scalarRowKernel, but sweeping along the row with a window of 3 column tallies. Moving one cell to the
+ * right only needs the tally of the one new column, so each cell reads 3 cells of currWorld instead of 9.
+ */
+static int slidingRowKernel(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int colStart, int colEnd)
+{
+    const cell_t *up = paddedRow(currWorld, row - 1);
+    const cell_t *mid = paddedRow(currWorld, row);
+    const cell_t *down = paddedRow(currWorld, row + 1);
+    cell_t *newRow = paddedRow(nextWorld, row);
+
+    int deaths = 0;
+    Tally left = columnTally(up, mid, down, colStart - 1);
+    Tally centre = columnTally(up, mid, down, colStart);
+    for (int col = colStart; col < colEnd; col++)
+    {
+        Tally right = columnTally(up, mid, down, col + 1);
+        Tally window = left + centre + right;
+        left = centre;
+        centre = right;
+
+        int cellFaction = mid[col];
+
+        // the window counted this cell as its own "neighbor"
+        Tally neighbors = window - ((Tally)1 << (4 * cellFaction));
+
+        if (cellFaction == DEAD_FACTION)
+        {
+            // isBirthable: exactly 3 of a single faction, the highest one wins
+            newRow[col] = highestTriple(neighbors);
+            continue;
+        }
+
+        int friendlyCount = TALLY_COUNT(neighbors, cellFaction);
+        int hostileCount = 8 - TALLY_COUNT(neighbors, DEAD_FACTION) - friendlyCount;
+        if (willFight(hostileCount))
+        {
+            deaths++;
+            newRow[col] = DEAD_FACTION;
+        }
+        else
+        {
+            newRow[col] = isSurvivable(friendlyCount) ? cellFaction : DEAD_FACTION;
+        }
+    }
+
+    return deaths;
+}
+
+#if PACKED_CELLS
+
+// kernel_vec.h is compiled once per instruction set, with cells per vector matching its register width
+
+#pragma GCC push_options
+#pragma GCC target("sse4.2,popcnt")
+#define VEC_CELLS 16
+#define VEC(name) name##Sse42
+#include "kernel_vec.h"
+#undef VEC
+#undef VEC_CELLS
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2,popcnt")
+#define VEC_CELLS 32
+#define VEC(name) name##Avx2
+#include "kernel_vec.h"
+#undef VEC
+#undef VEC_CELLS
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx512f,avx512bw,popcnt")
+#define VEC_CELLS 64
+#define VEC(name) name##Avx512
+#include "kernel_vec.h"
+#undef VEC
+#undef VEC_CELLS
+#pragma GCC pop_options
+
+#endif
+
+static const char *rowKernelNames[] = {"scalar", "sliding", "sse4.2", "avx2", "avx512"};
+
+static RowKernelKind rowKernelKind = ROW_KERNEL_SCALAR;
+static RowKernel rowKernel = scalarRowKernel;
+
+/**
+ * Picks the fastest row kernel this CPU supports. The vector kernels need PACKED_CELLS.
+ *
+ * The GOI_ROW_KERNEL environment variable overrides the choice, e.g. to compare kernels: scalar and sliding are
+ * always available, while asking for an instruction set (sse4.2, avx2 or avx512) the CPU does not have falls back
+ * to the best one it does.
+ *
+ * Must be called before nextRowState, and not concurrently with it.
+ */
+void initKernel(void)
+{
+    RowKernelKind best = ROW_KERNEL_SCALAR;
+#if PACKED_CELLS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw"))
+    {
+        best = ROW_KERNEL_AVX512;
+    }
+    else if (__builtin_cpu_supports("avx2"))
+    {
+        best = ROW_KERNEL_AVX2;
+    }
+    else if (__builtin_cpu_supports("sse4.2"))
+    {
+        best = ROW_KERNEL_SSE42;
+    }
+#else
+    best = ROW_KERNEL_SLIDING;
+#endif
+
+    const char *requested = getenv("GOI_ROW_KERNEL");
+    if (requested != NULL)
+    {
+        for (int kind = ROW_KERNEL_SCALAR; kind <= ROW_KERNEL_AVX512; kind++)
+        {
+            bool portable = kind == ROW_KERNEL_SCALAR || kind == ROW_KERNEL_SLIDING;
+            if (strcmp(requested, rowKernelNames[kind]) == 0 && (portable || kind < (int)best))
+            {
+                best = kind;
+            }
+        }
+    }
+
+    rowKernelKind = best;
+    switch (best)
+    {
+#if PACKED_CELLS
+    case ROW_KERNEL_AVX512:
+        rowKernel = vectorRowKernelAvx512;
+        break;
+    case ROW_KERNEL_AVX2:
+        rowKernel = vectorRowKernelAvx2;
+        break;
+    case ROW_KERNEL_SSE42:
+        rowKernel = vectorRowKernelSse42;
+        break;
+#endif
+    case ROW_KERNEL_SLIDING:
+        rowKernel = slidingRowKernel;
+        break;
+    default:
+        rowKernel = scalarRowKernel;
+        break;
+    }
+}
+
+RowKernelKind getRowKernelKind(void)
+{
+    return rowKernelKind;
+}
+
+const char *getRowKernelName(void)
+{
+    return rowKernelNames[rowKernelKind];
+}
+
+/**
+ * Lands faction on the cell at row and col of nextWorld, which must already hold the next state of the cell as if
+ * nothing landed there. Returns how many more cells count towards the death toll due to fighting because of it: a
+ * live cell that gets landed on dies fighting, whether or not it was going to anyway.
+ */
+int landInvader(const PaddedWorld *currWorld, PaddedWorld *nextWorld, int row, int col, int faction)
+{
+    bool diedDueToFighting;
+    getNextState(currWorld, row, col, &diedDueToFighting);
+    setPaddedValueAt(nextWorld, row, col, faction);
+    return (getPaddedValueAt(currWorld, row, col) != DEAD_FACTION) - diedDueToFighting;
+}
+
+/**
+ * Writes the next state of the cells [colStart, colEnd) of row, based on currWorld and invaders, into nextWorld.
+ * Returns the number of those cells that count towards the death toll due to fighting.
+ *
+ * invaders can be NULL if there are no invaders. The row is computed as if there were none, and then only the
+ * invaders of the row are landed on it. Rows of nextWorld other than row are not touched, so disjoint row segments
+ * can be computed concurrently.
+ */
+int nextRowState(const PaddedWorld *currWorld, const InvasionPlan *invaders, PaddedWorld *nextWorld, int row, int colStart, int colEnd)
+{
+    int deaths = rowKernel(currWorld, nextWorld, row, colStart, colEnd);
+    if (invaders != NULL)
+    {
+        const Invader *invader = findInvader(invaders, row, colStart);
+        for (; invader != endInvaders(invaders) && invader->row == row && invader->col < colEnd; invader++)
+        {
+            deaths += landInvader(currWorld, nextWorld, row, invader->col, invader->faction);
+        }
+    }
+    return deaths;
+}
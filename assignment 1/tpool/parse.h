@@ -0,0 +1,36 @@
+#ifndef PARSE_H
+#define PARSE_H
+
+#include <stdio.h>
+#include "input.h"
+
+// every chunk of rows that a thread parses at a time is about this many bytes of text
+#define PARSE_CHUNK_BYTES (256L * 1024)
+
+/**
+ * Parses a text input file on several threads.
+ *
+ * The file is mapped (or read whole, if it cannot be), and one pass over it finds where every line starts. Since
+ * every part of the file has a known number of lines, that is enough to know where every row of the start world and
+ * of every invasion plan is. Their rows are then cut into chunks of about PARSE_CHUNK_BYTES, which the threads take
+ * one at a time and decode with a digit parser of their own; a chunk of an invasion plan yields its own list of
+ * invaders, and the lists of a plan are joined in order at the end.
+ *
+ * A malformed file is rejected with the same message as when it was read line by line: that of the first part of the
+ * file that is wrong.
+ */
+int parseTextInput(FILE *fp, int nThreads, GoiInput *input);
+
+/**
+ * The rest of a text input file once its start world has been parsed, for its invasions to be parsed one at a time,
+ * just before they are needed (see stream.h). Only the lines up to the part being parsed are ever indexed, so a
+ * mapped file is only read from disk that far, and the pages of the parts already parsed are given back.
+ */
+typedef struct TextInput TextInput;
+
+TextInput *openTextInput(FILE *fp, int nThreads, GoiInput *input);
+const char *parseInvasionTime(TextInput *text, int *time);
+const char *parseInvasionPlan(TextInput *text, InvasionPlan **plan);
+void closeTextInput(TextInput *text);
+
+#endif
@@ -1,128 +1,668 @@
+#define _GNU_SOURCE
 #include "pthread_pool.h"
+#include "wait.h"
 #include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <stdio.h>
 
-struct pool_queue {
+#define CACHE_LINE_SIZE 64
+/* must be a power of 2 */
+#define POOL_QUEUE_CAPACITY (1 << 14)
+/* must be a power of 2 */
+#define DEQUE_INITIAL_CAPACITY 64
+/* the most tasks a worker moves from the queue to its deque at once, besides the one it runs */
+#define POOL_INJECT_BATCH 32
+/* a parallel range is cut into about this many chunks per thread, so that threads finishing early can take more */
+#define POOL_CHUNKS_PER_THREAD 4
+
+/*
+ * A range handed to the pool by pool_parallel_for or pool_parallel_reduce.
+ * Threads take chunks of it by bumping next, so chunks are handed out
+ * without a lock, and lives on the stack of the submitting thread until every
+ * chunk has run.
+ */
+struct pool_range {
+	pool_range_fn for_body;
+	pool_reduce_fn reduce_body;
+	pool_combine_fn combine;
+	void *ctx;
+	long next;
+	long end;
+	long chunk;
+};
+
+/* a thread's running result of pool_parallel_reduce, on its own cache line */
+struct pool_accumulator {
+	long value;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+struct pool_task {
 	void *arg;
+	struct pool_range *range;
 	char free;
-	struct pool_queue *next;
 };
 
+/*
+ * The circular buffer of a deque. capacity is a power of 2. When a deque
+ * outgrows its buffer, the old one is kept on the retired list until
+ * pool_end, since a thief may still be reading from it.
+ */
+struct deque_array {
+	long capacity;
+	struct deque_array *retired;
+	struct pool_task tasks[];
+};
+
+/*
+ * A Chase-Lev work-stealing deque (Chase and Lev, SPAA 2005, with the C11
+ * orderings of Le et al., PPoPP 2013).
+ *
+ * Only the worker owning it pushes and pops, at bottom; the other workers
+ * steal from top with a CAS, so no one ever locks it.
+ *
+ * top and bottom are on their own cache lines, since the thieves hammer top.
+ */
+struct deque {
+	long top __attribute__((aligned(CACHE_LINE_SIZE)));
+	long bottom __attribute__((aligned(CACHE_LINE_SIZE)));
+	struct deque_array *array;
+};
+
+/* a thread of the pool, its deque, and its index, which picks its accumulator */
+struct pool_worker {
+	struct pool *pool;
+	unsigned int index;
+	struct deque deque;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+/* the worker the calling thread is, if it is one */
+static __thread struct pool_worker *current_worker;
+
+/*
+ * A slot of the queue. seq tells whose turn the slot is: pos when it is free
+ * for the task at position pos, pos + 1 once that task is in it, and
+ * pos + POOL_QUEUE_CAPACITY once it has been taken again.
+ */
+struct pool_slot {
+	unsigned long seq;
+	void *arg;
+	/* set instead of arg if the task is to help with a parallel range */
+	struct pool_range *range;
+	char free;
+};
+
+/*
+ * Every worker has a work-stealing deque, and tasks enqueued from outside the
+ * pool go through an injection queue, a bounded multi-producer
+ * multi-consumer queue (Vyukov's bounded MPMC queue) embedded in the pool.
+ *
+ * A worker takes tasks from its own deque first, then from the queue, and
+ * only then steals from the other deques. A task enqueued by a worker goes to
+ * its own deque. A worker taking a task from a busy queue also moves a share
+ * of the rest into its deque, so that the workers mostly take tasks from
+ * their own deques and the queue is not hammered by all of them at once; the
+ * others steal whatever it does not get to.
+ *
+ * Tasks are stored in the slots of the queue themselves, so neither
+ * enqueueing nor taking a task allocates. Producers claim a position by a CAS
+ * on head and consumers one by a CAS on tail; the seq of the slot then says
+ * whether the claim can go ahead, so no thread ever waits on a lock for
+ * another.
+ *
+ * head and tail are on their own cache lines, since producers and consumers
+ * hammer them separately.
+ */
 struct pool {
-	char cancelled;
+	unsigned long head __attribute__((aligned(CACHE_LINE_SIZE)));
+	unsigned long tail __attribute__((aligned(CACHE_LINE_SIZE)));
+	char cancelled __attribute__((aligned(CACHE_LINE_SIZE)));
 	void *(*fn)(void *);
 	unsigned int remaining;
 	unsigned int nthreads;
-	struct pool_queue *q;
-	struct pool_queue *end;
+	/* how idle workers and pool_wait wait before parking */
+	WaitPolicy policy;
+	/* the number of workers parked on work_cnd, and of threads parked in pool_wait on done_cnd */
+	unsigned int sleepers;
+	unsigned int waiters;
+	pthread_t *threads;
+	struct pool_worker *workers;
+	/* one per thread and one for the thread submitting a parallel range */
+	struct pool_accumulator *accumulators;
+	/* guards parking: workers wait on work_cnd, pool_wait on done_cnd */
 	pthread_mutex_t q_mtx;
-	pthread_cond_t q_cnd;
-	pthread_t threads[1];
+	pthread_cond_t work_cnd;
+	pthread_cond_t done_cnd;
+	struct pool_slot slots[POOL_QUEUE_CAPACITY] __attribute__((aligned(CACHE_LINE_SIZE)));
 };
 
 static void * thread(void *arg);
 
+static struct deque_array * deque_array_new(long capacity) {
+	struct deque_array *a = (struct deque_array *) malloc(sizeof(struct deque_array) + capacity * sizeof(struct pool_task));
+	if (a == NULL) {
+		fprintf(stderr, "Failed to mem alloc for pool deque\n");
+		exit(1);
+	}
+	a->capacity = capacity;
+	a->retired = NULL;
+	return a;
+}
+
+static void deque_init(struct deque *d) {
+	d->top = 0;
+	d->bottom = 0;
+	d->array = deque_array_new(DEQUE_INITIAL_CAPACITY);
+}
+
+/*
+ * Doubles the buffer of d, which holds the tasks [t, b).
+ */
+static struct deque_array * deque_grow(struct deque *d, struct deque_array *a, long t, long b) {
+	struct deque_array *bigger = deque_array_new(a->capacity * 2);
+	long i;
+
+	for (i = t; i < b; i++) {
+		bigger->tasks[i & (bigger->capacity - 1)] = a->tasks[i & (a->capacity - 1)];
+	}
+	bigger->retired = a;
+	__atomic_store_n(&d->array, bigger, __ATOMIC_RELEASE);
+	return bigger;
+}
+
+/*
+ * Puts a task at the bottom of d. Only its owner may push.
+ */
+static void deque_push(struct deque *d, const struct pool_task *task) {
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED);
+	long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	struct deque_array *a = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+	struct pool_task *slot;
+
+	if (b - t >= a->capacity) {
+		a = deque_grow(d, a, t, b);
+	}
+	slot = &a->tasks[b & (a->capacity - 1)];
+	__atomic_store_n(&slot->arg, task->arg, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->range, task->range, __ATOMIC_RELAXED);
+	__atomic_store_n(&slot->free, task->free, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+}
+
+static void deque_read(struct deque_array *a, long i, struct pool_task *task) {
+	struct pool_task *slot = &a->tasks[i & (a->capacity - 1)];
+
+	task->arg = __atomic_load_n(&slot->arg, __ATOMIC_RELAXED);
+	task->range = __atomic_load_n(&slot->range, __ATOMIC_RELAXED);
+	task->free = __atomic_load_n(&slot->free, __ATOMIC_RELAXED);
+}
+
+/*
+ * Takes the task at the bottom of d into *task. Only its owner may pop.
+ *
+ * Returns 0 if d is empty.
+ */
+static int deque_pop(struct deque *d, struct pool_task *task) {
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_RELAXED) - 1;
+	struct deque_array *a = __atomic_load_n(&d->array, __ATOMIC_RELAXED);
+	long t;
+	int got = 1;
+
+	__atomic_store_n(&d->bottom, b, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	t = __atomic_load_n(&d->top, __ATOMIC_RELAXED);
+	if (t > b) {
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+		return 0;
+	}
+	deque_read(a, b, task);
+	if (t == b) {
+		/* the last task: a thief may be taking it too */
+		if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) got = 0;
+		__atomic_store_n(&d->bottom, b + 1, __ATOMIC_RELAXED);
+	}
+	return got;
+}
+
+/*
+ * Takes the task at the top of d into *task.
+ *
+ * Returns 1 if a task was taken, 0 if d is empty and -1 if another thread
+ * took the top task first (d may still have more).
+ */
+static int deque_steal(struct deque *d, struct pool_task *task) {
+	long t = __atomic_load_n(&d->top, __ATOMIC_ACQUIRE);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_ACQUIRE);
+
+	if (t >= b) {
+		return 0;
+	}
+	deque_read(__atomic_load_n(&d->array, __ATOMIC_ACQUIRE), t, task);
+	if (!__atomic_compare_exchange_n(&d->top, &t, t + 1, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+		return -1;
+	}
+	return 1;
+}
+
+static int deque_empty(struct deque *d) {
+	long t = __atomic_load_n(&d->top, __ATOMIC_SEQ_CST);
+	long b = __atomic_load_n(&d->bottom, __ATOMIC_SEQ_CST);
+	return t >= b;
+}
+
+/*
+ * Frees the tasks left in d (their args too, if they asked for it) and
+ * every buffer d has used. No other thread may touch d any more.
+ */
+static void deque_destroy(struct deque *d) {
+	struct deque_array *a = d->array;
+	struct deque_array *retired;
+	long i;
+
+	for (i = d->top; i < d->bottom; i++) {
+		if (a->tasks[i & (a->capacity - 1)].free) free(a->tasks[i & (a->capacity - 1)].arg);
+	}
+	while (a != NULL) {
+		retired = a->retired;
+		free(a);
+		a = retired;
+	}
+}
+
+/*
+ * Puts a task at the head of the queue.
+ *
+ * Returns 0 if the queue is full.
+ */
+static int queue_push(struct pool *p, void *arg, struct pool_range *range, char free) {
+	unsigned long pos = __atomic_load_n(&p->head, __ATOMIC_RELAXED);
+	struct pool_slot *slot;
+	unsigned long seq;
+	long diff;
+
+	for (;;) {
+		slot = &p->slots[pos & (POOL_QUEUE_CAPACITY - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		diff = (long) (seq - pos);
+		if (diff == 0) {
+			/* on failure, pos is reloaded with the current head */
+			if (__atomic_compare_exchange_n(&p->head, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+		} else if (diff < 0) {
+			/* the slot still holds the task from a lap ago */
+			return 0;
+		} else {
+			pos = __atomic_load_n(&p->head, __ATOMIC_RELAXED);
+		}
+	}
+
+	slot->arg = arg;
+	slot->range = range;
+	slot->free = free;
+	__atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/*
+ * Takes the task at the tail of the queue into *task.
+ *
+ * Returns 0 if the queue is empty.
+ */
+static int queue_pop(struct pool *p, struct pool_task *task) {
+	unsigned long pos = __atomic_load_n(&p->tail, __ATOMIC_RELAXED);
+	struct pool_slot *slot;
+	unsigned long seq;
+	long diff;
+
+	for (;;) {
+		slot = &p->slots[pos & (POOL_QUEUE_CAPACITY - 1)];
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		diff = (long) (seq - (pos + 1));
+		if (diff == 0) {
+			if (__atomic_compare_exchange_n(&p->tail, &pos, pos + 1, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) break;
+		} else if (diff < 0) {
+			/* no task has been put in this slot yet */
+			return 0;
+		} else {
+			pos = __atomic_load_n(&p->tail, __ATOMIC_RELAXED);
+		}
+	}
+
+	task->arg = slot->arg;
+	task->range = slot->range;
+	task->free = slot->free;
+	__atomic_store_n(&slot->seq, pos + POOL_QUEUE_CAPACITY, __ATOMIC_RELEASE);
+	return 1;
+}
+
+/*
+ * True if a task has been enqueued but not taken yet (or is about to be
+ * put in its slot), or is waiting in a deque.
+ */
+static int has_work(struct pool *p) {
+	unsigned int i;
+
+	if (__atomic_load_n(&p->tail, __ATOMIC_SEQ_CST) != __atomic_load_n(&p->head, __ATOMIC_SEQ_CST)) return 1;
+	for (i = 0; i < p->nthreads; i++) {
+		if (!deque_empty(&p->workers[i].deque)) return 1;
+	}
+	return 0;
+}
+
 void * pool_start(void * (*thread_func)(void *), unsigned int threads) {
-	struct pool *p = (struct pool *) malloc(sizeof(struct pool) + (threads-1) * sizeof(pthread_t));
-	int i;
+	struct pool *p;
+	unsigned long i;
+
+	if (posix_memalign((void **) &p, CACHE_LINE_SIZE, sizeof(struct pool)) != 0) {
+		fprintf(stderr, "Failed to mem alloc for pool\n");
+		exit(1);
+	}
+	p->threads = (pthread_t *) malloc(threads * sizeof(pthread_t));
+	if (p->threads == NULL || posix_memalign((void **) &p->workers, CACHE_LINE_SIZE, threads * sizeof(struct pool_worker)) != 0 || posix_memalign((void **) &p->accumulators, CACHE_LINE_SIZE, (threads + 1) * sizeof(struct pool_accumulator)) != 0) {
+		fprintf(stderr, "Failed to mem alloc for pool threads\n");
+		exit(1);
+	}
 
 	pthread_mutex_init(&p->q_mtx, NULL);
-	pthread_cond_init(&p->q_cnd, NULL);
+	pthread_cond_init(&p->work_cnd, NULL);
+	pthread_cond_init(&p->done_cnd, NULL);
 	p->nthreads = threads;
 	p->fn = thread_func;
 	p->cancelled = 0;
 	p->remaining = 0;
-	p->end = NULL;
-	p->q = NULL;
+	p->sleepers = 0;
+	p->waiters = 0;
+	p->policy = getWaitPolicy();
+	p->head = 0;
+	p->tail = 0;
+	for (i = 0; i < POOL_QUEUE_CAPACITY; i++) {
+		p->slots[i].seq = i;
+	}
 
 	for (i = 0; i < threads; i++) {
-		pthread_create(&p->threads[i], NULL, &thread, p);
+		p->workers[i].pool = p;
+		p->workers[i].index = i;
+		deque_init(&p->workers[i].deque);
+	}
+
+	for (i = 0; i < threads; i++) {
+		pthread_create(&p->threads[i], NULL, &thread, &p->workers[i]);
 	}
 
 	return p;
 }
 
+/*
+ * Never locks unless a worker has to be woken up, and only allocates if a
+ * worker's deque has to grow. If the queue is full, this yields until the
+ * workers have made room.
+ */
+static void submit(struct pool *p, void *arg, struct pool_range *range, char free) {
+	struct pool_task task = { arg, range, free };
+
+	/* count the task before anyone can run it, so remaining never underflows */
+	__atomic_add_fetch(&p->remaining, 1, __ATOMIC_SEQ_CST);
+
+	if (current_worker != NULL && current_worker->pool == p) {
+		deque_push(&current_worker->deque, &task);
+	} else {
+		while (!queue_push(p, arg, range, free)) {
+			sched_yield();
+		}
+	}
+
+	/* pairs with the sleepers increment in park: either a parking worker sees the task, or we see it parking */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&p->sleepers, __ATOMIC_SEQ_CST) > 0) {
+		pthread_mutex_lock(&p->q_mtx);
+		pthread_cond_signal(&p->work_cnd);
+		pthread_mutex_unlock(&p->q_mtx);
+	}
+}
+
 void pool_enqueue(void *pool, void *arg, char free) {
+	submit((struct pool *) pool, arg, NULL, free);
+}
+
+/*
+ * Runs chunks of range until none is left, folding the results of a reduce
+ * into the accumulator of thread index.
+ */
+static void run_range(struct pool *p, struct pool_range *range, unsigned int index) {
+	long begin, end;
+
+	while ((begin = __atomic_fetch_add(&range->next, range->chunk, __ATOMIC_RELAXED)) < range->end) {
+		end = range->end - begin > range->chunk ? begin + range->chunk : range->end;
+		if (range->reduce_body == NULL) {
+			range->for_body(range->ctx, begin, end);
+		} else if (range->combine == NULL) {
+			p->accumulators[index].value += range->reduce_body(range->ctx, begin, end);
+		} else {
+			p->accumulators[index].value = range->combine(p->accumulators[index].value, range->reduce_body(range->ctx, begin, end));
+		}
+	}
+}
+
+/*
+ * Cuts [begin, end) into chunks of at least grain indices, has as many
+ * threads help with them as there are chunks to share, runs chunks on this
+ * thread too, and waits for the rest. Returns the combined accumulators.
+ */
+static long run_parallel(struct pool *p, long begin, long end, long grain, struct pool_range *range, long identity) {
+	long chunks, helpers, result;
+	unsigned int i;
+
+	if (begin >= end) return identity;
+
+	range->next = begin;
+	range->end = end;
+	range->chunk = (end - begin + (long) p->nthreads * POOL_CHUNKS_PER_THREAD - 1) / ((long) p->nthreads * POOL_CHUNKS_PER_THREAD);
+	if (range->chunk < grain) range->chunk = grain;
+	if (range->chunk < 1) range->chunk = 1;
+	for (i = 0; i <= p->nthreads; i++) {
+		p->accumulators[i].value = identity;
+	}
+
+	chunks = (end - begin + range->chunk - 1) / range->chunk;
+	helpers = chunks - 1 < (long) p->nthreads ? chunks - 1 : (long) p->nthreads;
+	for (i = 0; i < helpers; i++) {
+		submit(p, NULL, range, 0);
+	}
+	run_range(p, range, p->nthreads);
+	pool_wait(p);
+
+	result = identity;
+	for (i = 0; i <= p->nthreads; i++) {
+		if (range->combine == NULL) {
+			result += p->accumulators[i].value;
+		} else {
+			result = range->combine(result, p->accumulators[i].value);
+		}
+	}
+	return result;
+}
+
+void pool_parallel_for(void *pool, long begin, long end, long grain, pool_range_fn body, void *ctx) {
+	struct pool_range range = { body, NULL, NULL, ctx, 0, 0, 0 };
+
+	run_parallel((struct pool *) pool, begin, end, grain, &range, 0);
+}
+
+long pool_parallel_reduce(void *pool, long begin, long end, long grain, pool_reduce_fn body, pool_combine_fn combine, long identity, void *ctx) {
+	struct pool_range range = { NULL, body, combine, ctx, 0, 0, 0 };
+
+	return run_parallel((struct pool *) pool, begin, end, grain, &range, identity);
+}
+
+void pool_set_affinity(void *pool, int (*cpu_of)(int index)) {
 	struct pool *p = (struct pool *) pool;
-	struct pool_queue *q = (struct pool_queue *) malloc(sizeof(struct pool_queue));
-	q->arg = arg;
-	q->next = NULL;
-	q->free = free;
+	cpu_set_t cpus;
+	unsigned int i;
+	int cpu;
 
-	pthread_mutex_lock(&p->q_mtx);
-	if (p->end != NULL) p->end->next = q;
-	if (p->q == NULL) p->q = q;
-	p->end = q;
-	p->remaining++;
-	pthread_cond_signal(&p->q_cnd);
-	pthread_mutex_unlock(&p->q_mtx);
+	for (i = 0; i < p->nthreads; i++) {
+		cpu = cpu_of(i + 1);
+		if (cpu < 0) continue;
+		CPU_ZERO(&cpus);
+		CPU_SET(cpu, &cpus);
+		pthread_setaffinity_np(p->threads[i], sizeof(cpus), &cpus);
+	}
+}
+
+void pool_set_wait_policy(void *pool, WaitPolicy policy) {
+	struct pool *p = (struct pool *) pool;
+
+	__atomic_store_n(&p->policy, policy, __ATOMIC_RELAXED);
 }
 
+/*
+ * Waits by the policy of the pool, and only parks on done_cnd once it is used
+ * up; a finishing worker then only takes the lock if someone is parked.
+ */
 void pool_wait(void *pool) {
 	struct pool *p = (struct pool *) pool;
+	Backoff wait;
 
-	pthread_mutex_lock(&p->q_mtx);
-	while (!p->cancelled && p->remaining) {
-		pthread_cond_wait(&p->q_cnd, &p->q_mtx);
+	initBackoff(&wait, __atomic_load_n(&p->policy, __ATOMIC_RELAXED));
+	while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE) && __atomic_load_n(&p->remaining, __ATOMIC_ACQUIRE)) {
+		if (backoff(&wait)) continue;
+
+		pthread_mutex_lock(&p->q_mtx);
+		/* pairs with the remaining decrement in thread: either it sees us waiting, or we see remaining reach 0 */
+		__atomic_add_fetch(&p->waiters, 1, __ATOMIC_SEQ_CST);
+		while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE) && __atomic_load_n(&p->remaining, __ATOMIC_SEQ_CST)) {
+			pthread_cond_wait(&p->done_cnd, &p->q_mtx);
+		}
+		__atomic_sub_fetch(&p->waiters, 1, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&p->q_mtx);
 	}
-	pthread_mutex_unlock(&p->q_mtx);
 }
 
 void pool_end(void *pool) {
 	struct pool *p = (struct pool *) pool;
-	struct pool_queue *q;
+	struct pool_task task;
 	int i;
 
-	p->cancelled = 1;
+	__atomic_store_n(&p->cancelled, 1, __ATOMIC_RELEASE);
 
 	pthread_mutex_lock(&p->q_mtx);
-	pthread_cond_broadcast(&p->q_cnd);
+	pthread_cond_broadcast(&p->work_cnd);
+	pthread_cond_broadcast(&p->done_cnd);
 	pthread_mutex_unlock(&p->q_mtx);
 
 	for (i = 0; i < p->nthreads; i++) {
 		pthread_join(p->threads[i], NULL);
 	}
 
-	while (p->q != NULL) {
-		q = p->q;
-		p->q = q->next;
-
-		if (q->free) free(q->arg);
-		free(q);
+	while (queue_pop(p, &task)) {
+		if (task.free) free(task.arg);
+	}
+	for (i = 0; i < p->nthreads; i++) {
+		deque_destroy(&p->workers[i].deque);
 	}
 
+	pthread_mutex_destroy(&p->q_mtx);
+	pthread_cond_destroy(&p->work_cnd);
+	pthread_cond_destroy(&p->done_cnd);
+	free(p->threads);
+	free(p->workers);
+	free(p->accumulators);
 	free(p);
 }
 
-static void * thread(void *arg) {
-	struct pool_queue *q;
-	struct pool *p = (struct pool *) arg;
-
-	while (!p->cancelled) {
+/*
+ * Wakes parked workers to steal tasks just moved into a deque, if any are
+ * parked.
+ */
+static void wake_thieves(struct pool *p) {
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&p->sleepers, __ATOMIC_SEQ_CST) > 0) {
 		pthread_mutex_lock(&p->q_mtx);
-		while (!p->cancelled && p->q == NULL) {
-			pthread_cond_wait(&p->q_cnd, &p->q_mtx);
+		pthread_cond_broadcast(&p->work_cnd);
+		pthread_mutex_unlock(&p->q_mtx);
+	}
+}
+
+/*
+ * Takes a task for worker self into *task: from its own deque first, then
+ * from the queue, moving a share of what is left in it into its deque, then
+ * by stealing from the others, starting with its neighbour.
+ *
+ * Returns 0 if there was no task anywhere.
+ */
+static int take(struct pool *p, struct pool_worker *self, struct pool_task *task) {
+	struct pool_task extra;
+	long queued, batch;
+	unsigned int i, victim;
+	int got;
+
+	if (deque_pop(&self->deque, task)) return 1;
+
+	if (queue_pop(p, task)) {
+		queued = (long) (__atomic_load_n(&p->head, __ATOMIC_RELAXED) - __atomic_load_n(&p->tail, __ATOMIC_RELAXED));
+		batch = queued / p->nthreads < POOL_INJECT_BATCH ? queued / p->nthreads : POOL_INJECT_BATCH;
+		for (i = 0; i < batch && queue_pop(p, &extra); i++) {
+			deque_push(&self->deque, &extra);
 		}
-		if (p->cancelled) {
-			pthread_mutex_unlock(&p->q_mtx);
-			return NULL;
+		if (i > 0) wake_thieves(p);
+		return 1;
+	}
+
+	for (i = 1; i < p->nthreads; i++) {
+		victim = (self->index + i) % p->nthreads;
+		do {
+			got = deque_steal(&p->workers[victim].deque, task);
+		} while (got < 0);
+		if (got) return 1;
+	}
+	return 0;
+}
+
+/*
+ * Sleeps until there may be a task to take or the pool is cancelled.
+ */
+static void park(struct pool *p) {
+	pthread_mutex_lock(&p->q_mtx);
+	__atomic_add_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+	while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE) && !has_work(p)) {
+		pthread_cond_wait(&p->work_cnd, &p->q_mtx);
+	}
+	__atomic_sub_fetch(&p->sleepers, 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&p->q_mtx);
+}
+
+static void * thread(void *arg) {
+	struct pool_worker *self = (struct pool_worker *) arg;
+	struct pool *p = self->pool;
+	struct pool_task task;
+	Backoff wait;
+
+	current_worker = self;
+	initBackoff(&wait, __atomic_load_n(&p->policy, __ATOMIC_RELAXED));
+	while (!__atomic_load_n(&p->cancelled, __ATOMIC_ACQUIRE)) {
+		if (!take(p, self, &task)) {
+			if (!backoff(&wait)) {
+				park(p);
+				initBackoff(&wait, __atomic_load_n(&p->policy, __ATOMIC_RELAXED));
+			}
+			continue;
 		}
-		q = p->q;
-		p->q = q->next;
-		p->end = (q == p->end ? NULL : p->end);
-		pthread_mutex_unlock(&p->q_mtx);
+		initBackoff(&wait, __atomic_load_n(&p->policy, __ATOMIC_RELAXED));
 
-		p->fn(q->arg);
+		if (task.range != NULL) {
+			run_range(p, task.range, self->index);
+		} else {
+			p->fn(task.arg);
+		}
 
-		if (q->free) free(q->arg);
-		free(q);
-		q = NULL;
+		if (task.free) free(task.arg);
 
-		pthread_mutex_lock(&p->q_mtx);
-		p->remaining--;
-		pthread_cond_broadcast(&p->q_cnd);
-		pthread_mutex_unlock(&p->q_mtx);
+		if (__atomic_sub_fetch(&p->remaining, 1, __ATOMIC_SEQ_CST) == 0 && __atomic_load_n(&p->waiters, __ATOMIC_SEQ_CST) > 0) {
+			pthread_mutex_lock(&p->q_mtx);
+			pthread_cond_broadcast(&p->done_cnd);
+			pthread_mutex_unlock(&p->q_mtx);
+		}
 	}
 
 	return NULL;
@@ -3,6 +3,8 @@
  */
 
 #ifndef __PTHREAD_POOL_H__
+#include "wait.h"
+
 /**
  * Create a new thread pool.
  * 
@@ -10,7 +12,17 @@
  * once per queued task with its sole argument being the argument given to
  * pool_enqueue.
  *
+ * Each thread has its own work-stealing deque, and tasks queued from outside
+ * the pool go through a bounded lock-free injection queue whose slots hold
+ * the tasks themselves. A thread takes tasks from its own deque, then from
+ * the queue, and steals from the others once both are empty, so taking a
+ * task never takes a lock; a lock is only taken to park or wake a thread.
+ *
+ * Idle workers and pool_wait wait by the policy set by GOI_WAIT_POLICY (see
+ * wait.h), which pool_set_wait_policy can change.
+ *
  * \param thread_func The function executed by each thread for each work item.
+ *                    May be NULL if only parallel ranges are run.
  * \param threads The number of threads in the pool.
  * \return A pointer to the thread pool.
  */
@@ -25,6 +37,61 @@ void * pool_start(void * (*thread_func)(void *), unsigned int threads);
  */
 void pool_enqueue(void *pool, void *arg, char free);
 
+/** The body of pool_parallel_for, run on the indices [begin, end). */
+typedef void (*pool_range_fn)(void *ctx, long begin, long end);
+/** The body of pool_parallel_reduce, returning the result for [begin, end). */
+typedef long (*pool_reduce_fn)(void *ctx, long begin, long end);
+/** Combines two partial results of pool_parallel_reduce. */
+typedef long (*pool_combine_fn)(long a, long b);
+
+/**
+ * Run body over the indices [begin, end), split across the pool and the
+ * calling thread, and return once all of it has run.
+ *
+ * The range is cut into chunks of at least grain indices, a few per thread,
+ * which threads take as they become free. The range is submitted once, as at
+ * most one queued task per thread, and chunks are handed out with an atomic
+ * counter, so neither allocates or takes a lock.
+ *
+ * Only one parallel range may be run on a pool at a time. Like pool_wait, this
+ * also waits for any other queued task.
+ *
+ * \param pool A thread pool returned by start_pool.
+ * \param grain The fewest indices worth a chunk; 0 lets the pool decide.
+ * \param ctx Passed to every call of body.
+ */
+void pool_parallel_for(void *pool, long begin, long end, long grain, pool_range_fn body, void *ctx);
+
+/**
+ * Like pool_parallel_for, but body returns a result for its chunk and the
+ * results of all chunks are combined.
+ *
+ * Every thread folds the results of the chunks it runs into an accumulator of
+ * its own, on its own cache line, and the accumulators are only combined once
+ * all chunks have run, so threads never contend over the result.
+ *
+ * \param combine An associative and commutative function combining two
+ *                results, or NULL to add them.
+ * \param identity The result of an empty range, e.g. 0 for a sum.
+ * \return identity combined with the results of all chunks.
+ */
+long pool_parallel_reduce(void *pool, long begin, long end, long grain, pool_reduce_fn body, pool_combine_fn combine, long identity, void *ctx);
+
+/**
+ * Set how idle workers and pool_wait wait: park right away, spin, or spin
+ * for a while and then park. Workers pick it up the next time they wait.
+ */
+void pool_set_wait_policy(void *pool, WaitPolicy policy);
+
+/**
+ * Pin every thread of the pool to a CPU.
+ *
+ * \param cpu_of Returns the CPU for thread index, counted from 1 (0 being
+ *               the thread that runs parallel ranges along with the pool),
+ *               or -1 to leave the thread where it is.
+ */
+void pool_set_affinity(void *pool, int (*cpu_of)(int index));
+
 /**
  * Wait for all queued tasks to be completed.
  */
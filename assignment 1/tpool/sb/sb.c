@@ -23,8 +23,8 @@
 /*
  * C String Builder - https://github.com/cavaliercoder/c-stringbuilder
  *
- * sb.c is a simple, non-thread safe String Builder that makes use of a
- * dynamically-allocated linked-list to enable linear time appending and
+ * sb.c is a simple, non-thread safe String Builder that appends into one
+ * contiguous, growable buffer, to enable amortized linear time appending and
  * concatenation.
  */
 #include <stdlib.h>
@@ -48,57 +48,141 @@ StringBuilder *sb_create()
  */
 int sb_empty(StringBuilder *sb)
 {
-	return (sb->root == NULL);
+	return (sb->length == 0);
 }
 
 /*
- * sb_append adds a copy of the given string to a StringBuilder.
+ * sb_reserve makes room for length more characters (and a terminating null)
+ * in a StringBuilder, doubling its buffer as many times as that takes. It
+ * returns SB_FAILURE, and marks the StringBuilder as failed, if memory is not
+ * available.
  */
-int sb_append(StringBuilder *sb, const char *str)
+static int sb_reserve(StringBuilder *sb, long length)
 {
-	int				length = 0;
-	StringFragment	*frag = NULL;
+	long	capacity = 0;
+	char	*str = NULL;
 
-	if (NULL == str || '\0' == *str)
-		return sb->length;
+	if (sb->failed)
+		return SB_FAILURE;
 
-	length = strlen(str);
-	frag = (StringFragment*) malloc(sizeof(StringFragment) + (sizeof(char) * length));
-	if (NULL == frag)
+	if (sb->length + length + 1 <= sb->capacity)
+		return 0;
+
+	capacity = sb->capacity > 0 ? sb->capacity : SB_MIN_CAPACITY;
+	while (capacity < sb->length + length + 1)
+		capacity *= 2;
+
+	str = (char*) realloc(sb->str, sizeof(char) * capacity);
+	if (NULL == str) {
+		sb->failed = 1;
 		return SB_FAILURE;
+	}
 
-	frag->next = NULL;
-	frag->length = length;
-	memcpy((void*) &frag->str, (const void*) str, sizeof(char) * (length + 1));
+	sb->str = str;
+	sb->capacity = capacity;
+	return 0;
+}
 
+/*
+ * sb_appendn adds a copy of the first length characters of the given string to
+ * a StringBuilder.
+ */
+long sb_appendn(StringBuilder *sb, const char *str, long length)
+{
+	if (SB_FAILURE == sb_reserve(sb, length))
+		return SB_FAILURE;
+
+	memcpy(sb->str + sb->length, str, sizeof(char) * length);
 	sb->length += length;
-	if (NULL == sb->root)
-		sb->root = frag;
-	else
-		sb->trunk->next = frag;
+	sb->str[sb->length] = '\0';
+
+	return sb->length;
+}
+
+/*
+ * sb_append adds a copy of the given string to a StringBuilder.
+ */
+long sb_append(StringBuilder *sb, const char *str)
+{
+	if (NULL == str || '\0' == *str)
+		return sb->failed ? SB_FAILURE : sb->length;
 
-	sb->trunk = frag;
+	return sb_appendn(sb, str, strlen(str));
+}
+
+/*
+ * sb_appendc adds the given character to a StringBuilder.
+ */
+long sb_appendc(StringBuilder *sb, char c)
+{
+	if (SB_FAILURE == sb_reserve(sb, 1))
+		return SB_FAILURE;
+
+	sb->str[sb->length++] = c;
+	sb->str[sb->length] = '\0';
 
 	return sb->length;
 }
 
 /*
- * sb_appendf adds a copy of the given formatted string to a StringBuilder.
+ * sb_appendint adds the given integer, in decimal, to a StringBuilder. It
+ * formats the integer itself rather than through printf.
+ */
+long sb_appendint(StringBuilder *sb, long value)
+{
+	char			buf[24];
+	char			*c = buf + sizeof(buf);
+	unsigned long	magnitude = value < 0 ? 0UL - (unsigned long) value : (unsigned long) value;
+
+	/* a single digit, like every cell of a world, needs no loop */
+	if (magnitude < 10 && value >= 0)
+		return sb_appendc(sb, (char) ('0' + magnitude));
+
+	do {
+		*--c = (char) ('0' + magnitude % 10);
+		magnitude /= 10;
+	} while (magnitude > 0);
+
+	if (value < 0)
+		*--c = '-';
+
+	return sb_appendn(sb, c, buf + sizeof(buf) - c);
+}
+
+/*
+ * sb_appendf adds a copy of the given formatted string to a StringBuilder. The
+ * string is formatted straight into the buffer, which grows to fit it.
  */
-int sb_appendf(StringBuilder *sb, const char *format, ...)
+long sb_appendf(StringBuilder *sb, const char *format, ...)
 {
 	int			rc = 0;
-	char		buf[SB_MAX_FRAG_LENGTH];
 	va_list		args;
 
-	va_start (args, format);
-	rc = vsnprintf(&buf[0], SB_MAX_FRAG_LENGTH, format, args);
+	if (SB_FAILURE == sb_reserve(sb, 0))
+		return SB_FAILURE;
+
+	va_start(args, format);
+	rc = vsnprintf(sb->str + sb->length, sb->capacity - sb->length, format, args);
 	va_end(args);
 
 	if (0 > rc)
 		return SB_FAILURE;
 
-	return sb_append(sb, buf);
+	/* it did not fit: make room for it and format it again */
+	if (sb->length + rc + 1 > sb->capacity) {
+		if (SB_FAILURE == sb_reserve(sb, rc))
+			return SB_FAILURE;
+
+		va_start(args, format);
+		rc = vsnprintf(sb->str + sb->length, sb->capacity - sb->length, format, args);
+		va_end(args);
+
+		if (0 > rc)
+			return SB_FAILURE;
+	}
+
+	sb->length += rc;
+	return sb->length;
 }
 
 /*
@@ -107,55 +191,59 @@ int sb_appendf(StringBuilder *sb, const char *format, ...)
  * reference.
  *
  * The StringBuilder is not modified by this function and can therefore continue
- * to be used.
+ * to be used. To write the strings out, sb_write does so without the copy.
  */
 char *sb_concat(StringBuilder *sb)
 {
-	char			*buf = NULL;
-	char			*c = NULL;
-	StringFragment	*frag = NULL;
+	char	*buf = NULL;
+
+	if (sb->failed)
+		return NULL;
 
 	buf = (char *) malloc((sb->length + 1) * sizeof(char));
 	if (NULL == buf)
 		return NULL;
 
-	c = buf;
-	for (frag = sb->root; frag; frag = frag->next) {
-		memcpy(c, &frag->str, sizeof(char) * frag->length);
-		c += frag->length;
-	}
-
-	*c = '\0';
+	if (sb->length > 0)
+		memcpy(buf, sb->str, sizeof(char) * sb->length);
+	buf[sb->length] = '\0';
 
 	return buf;
 }
 
 /*
- * sb_reset resets the given StringBuilder, freeing all previously appended
- * strings.
+ * sb_write writes the strings that have been appended to the StringBuilder
+ * straight to the given file. It returns SB_FAILURE if any of them could not be
+ * appended, or if writing fails.
  */
-void sb_reset(StringBuilder *sb)
+int sb_write(StringBuilder *sb, FILE *fp)
 {
-	StringFragment *frag = NULL;
-	StringFragment *next = NULL;
-
-	frag = sb->root;
-	while(frag) {
-		next = frag->next;
-		free(frag);
-		frag = next;
-	}
+	if (sb->failed)
+		return SB_FAILURE;
 
-	sb->root = NULL;
-	sb->trunk = NULL;
+	if (sb->length > 0 && fwrite(sb->str, sizeof(char), sb->length, fp) != (size_t) sb->length)
+		return SB_FAILURE;
+
+	return 0;
+}
+
+/*
+ * sb_reset empties the given StringBuilder. Its buffer is kept, so that it can
+ * be filled again without growing.
+ */
+void sb_reset(StringBuilder *sb)
+{
 	sb->length = 0;
+	sb->failed = 0;
+	if (sb->str)
+		sb->str[0] = '\0';
 }
 
 /*
- * sb_free frees the given StringBuilder and all of its appended strings.
+ * sb_free frees the given StringBuilder and its buffer.
  */
 void sb_free(StringBuilder *sb)
 {
-	sb_reset(sb);
+	free(sb->str);
 	free(sb);
 }
@@ -1,8 +1,11 @@
 #ifndef UTIL_H
 #define UTIL_H
 
-int getValueAt(const int *grid, int nRows, int nCols, int row, int col);
-void setValueAt(int *grid, int nRows, int nCols, int row, int col, int val);
-void printWorld(const int *world, int nRows, int nCols);
+#include "grid.h"
+
+int getValueAt(const cell_t *grid, int nRows, int nCols, int row, int col);
+void setValueAt(cell_t *grid, int nRows, int nCols, int row, int col, int val);
+void printWorld(const cell_t *world, int nRows, int nCols);
+void outputWorld(const cell_t *world, int nRows, int nCols, int generation);
 
 #endif
@@ -0,0 +1,147 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <unistd.h>
+#include "wait.h"
+
+static const char *waitPolicyNames[] = {"park", "spin", "adaptive"};
+
+/**
+ * Returns the policy selected by the GOI_WAIT_POLICY environment variable (park, spin or adaptive).
+ *
+ * If it is unset or unknown, this is adaptive, unless there is only one CPU: a spinning thread then only holds up
+ * the thread it waits for, so it parks right away.
+ */
+WaitPolicy getWaitPolicy(void)
+{
+    const char *requested = getenv("GOI_WAIT_POLICY");
+    if (requested != NULL)
+    {
+        for (int policy = WAIT_PARK; policy <= WAIT_ADAPTIVE; policy++)
+        {
+            if (strcmp(requested, waitPolicyNames[policy]) == 0)
+            {
+                return policy;
+            }
+        }
+    }
+    return sysconf(_SC_NPROCESSORS_ONLN) > 1 ? WAIT_ADAPTIVE : WAIT_PARK;
+}
+
+const char *getWaitPolicyName(WaitPolicy policy)
+{
+    return waitPolicyNames[policy];
+}
+
+/**
+ * Tells the core this is a spin loop, so that it backs off its sibling hyperthread and the memory bus.
+ */
+static inline void cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+void initBackoff(Backoff *backoff, WaitPolicy policy)
+{
+    backoff->policy = policy;
+    backoff->rounds = 0;
+}
+
+/**
+ * Waits a little, as the next round of the policy. Returns false, without waiting, once the waiter should park
+ * instead; it then goes on doing so.
+ */
+bool backoff(Backoff *backoff)
+{
+    if (backoff->policy == WAIT_PARK)
+    {
+        return false;
+    }
+    if (backoff->rounds < WAIT_SPIN_ROUNDS)
+    {
+        backoff->rounds++;
+        cpuRelax();
+        return true;
+    }
+    if (backoff->policy == WAIT_SPIN || backoff->rounds < WAIT_SPIN_ROUNDS + WAIT_YIELD_ROUNDS)
+    {
+        backoff->rounds++;
+        sched_yield();
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Returns 0 on success and -1 if the lock or condition variable cannot be set up.
+ */
+int initBarrier(Barrier *barrier, unsigned int nThreads, WaitPolicy policy)
+{
+    barrier->nThreads = nThreads;
+    barrier->arrived = 0;
+    barrier->generation = 0;
+    barrier->sleepers = 0;
+    barrier->policy = policy;
+    if (pthread_mutex_init(&barrier->lock, NULL) != 0)
+    {
+        return -1;
+    }
+    if (pthread_cond_init(&barrier->cond, NULL) != 0)
+    {
+        pthread_mutex_destroy(&barrier->lock);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Returns once all nThreads threads have called it. Everything a thread did before arriving is visible to every
+ * thread after it returns.
+ */
+void waitBarrier(Barrier *barrier)
+{
+    unsigned int generation = __atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE);
+
+    if (__atomic_add_fetch(&barrier->arrived, 1, __ATOMIC_ACQ_REL) == barrier->nThreads)
+    {
+        // nobody can arrive again before generation changes, so arrived can be reset first
+        __atomic_store_n(&barrier->arrived, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&barrier->generation, generation + 1, __ATOMIC_SEQ_CST);
+        // pairs with the sleepers increment below: either a parking thread sees the new generation, or we see it
+        if (__atomic_load_n(&barrier->sleepers, __ATOMIC_SEQ_CST) > 0)
+        {
+            pthread_mutex_lock(&barrier->lock);
+            pthread_cond_broadcast(&barrier->cond);
+            pthread_mutex_unlock(&barrier->lock);
+        }
+        return;
+    }
+
+    Backoff wait;
+    initBackoff(&wait, barrier->policy);
+    while (__atomic_load_n(&barrier->generation, __ATOMIC_ACQUIRE) == generation)
+    {
+        if (backoff(&wait))
+        {
+            continue;
+        }
+        pthread_mutex_lock(&barrier->lock);
+        __atomic_add_fetch(&barrier->sleepers, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&barrier->generation, __ATOMIC_SEQ_CST) == generation)
+        {
+            pthread_cond_wait(&barrier->cond, &barrier->lock);
+        }
+        __atomic_sub_fetch(&barrier->sleepers, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&barrier->lock);
+    }
+}
+
+void destroyBarrier(Barrier *barrier)
+{
+    pthread_mutex_destroy(&barrier->lock);
+    pthread_cond_destroy(&barrier->cond);
+}
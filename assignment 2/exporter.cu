@@ -67,37 +67,35 @@ void exportWorld(const int *world, int nRows, int nCols)
     sb_append(sb, ":[");
     for (int row = 0; row < nRows; row++)
     {
-        sb_append(sb, "[");
+        sb_appendc(sb, '[');
         for (int col = 0; col < nCols; col++)
         {
-            sb_appendf(sb, "%d", exporterGetValueAt(world, nRows, nCols, row, col));
+            sb_appendint(sb, exporterGetValueAt(world, nRows, nCols, row, col));
             if (col != nCols - 1) {
-                sb_append(sb, ",");
+                sb_appendc(sb, ',');
             }
         }
-        sb_append(sb, "]");
+        sb_appendc(sb, ']');
         if (row != nRows - 1) {
-            sb_append(sb, ",");
+            sb_appendc(sb, ',');
         }
     }
-    sb_append(sb, "]}\n");
 
-    char *s = sb_concat(sb);
-    if (s == NULL)
+    // an append that failed makes every later one fail too, so only the last needs checking
+    if (sb_append(sb, "]}\n") == SB_FAILURE)
     {
         fprintf(stderr, "Error: out of memory!\n");
         sb_free(sb);
         return;
     }
 
-    if (fputs(s, exportFile) == EOF)
+    // the line is written straight from the builder, without copying it out
+    if (sb_write(sb, exportFile) == SB_FAILURE)
     {
         fprintf(stderr, "Error: cannot export to file.\n");
-        free(s);
         sb_free(sb);
         return;
     }
 
-    free(s);
     sb_free(sb);
 }
\ No newline at end of file
@@ -1,10 +1,53 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "util.h"
 
+#define MAX_FACTIONS 10
+#define DEAD_FACTION 0
+
+// the first 4 bytes of a binary input file; a text input file starts with a digit
+#define BINARY_INPUT_MAGIC "GOIB"
+#define BINARY_INPUT_VERSION 1
+
+// The header of a binary input file, as written by goi_convert.out of assignment 1 (see its input.h). Every field
+// is in the byte order of the machine that wrote it.
+//
+// The header is followed by, in order and each starting on an 8-byte boundary:
+// - the invasion times: nInvasions int32_t
+// - the invasion index: nInvasions BinaryInvasion
+// - the start world: nRows * nCols cells of one byte each, row by row
+// - the invaders of every invasion, where its BinaryInvasion points: nInvaders Invader each, in row-major order
+typedef struct BinaryHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t nGenerations;
+    int32_t nRows;
+    int32_t nCols;
+    int32_t nInvasions;
+} BinaryHeader;
+
+typedef struct BinaryInvasion {
+    // from the start of the file
+    uint64_t offset;
+    uint64_t nInvaders;
+} BinaryInvasion;
+
+// a cell that an invasion lands on, and the faction that lands there
+typedef struct Invader {
+    int32_t row;
+    int32_t col;
+    int32_t faction;
+} Invader;
+
 int readParam(FILE *fp, char **line, size_t *len, int *param);
 int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, int nCols);
+bool isBinaryInput(FILE *fp);
+int mapBinaryInput(FILE *fp, int *nGenerations, int *nRows, int *nCols, int **startWorld, int *nInvasions, int **invasionTimes, int ***invasionPlans);
 
 int main(int argc, char** argv)
 {
@@ -101,65 +144,72 @@ int main(int argc, char** argv)
     // Read input file
     char *line = NULL;
     size_t len = 0;
-    // Read nGenerations
-    if (readParam(INPUT_FILE, &line, &len, &N_GENERATIONS) == -1) {
-        fprintf(stderr, "Failed to read N_GENERATIONS. Aborting...\n");
-        exit(EXIT_FAILURE);
-    }
-    // Read nRows
-    if (readParam(INPUT_FILE, &line, &len, &N_ROWS) == -1) {
-        fprintf(stderr, "Failed to read N_ROWS. Aborting...\n");
-        exit(1);
-    }
-
-    // Read nCols
-    if (readParam(INPUT_FILE, &line, &len, &N_COLS) == -1) {
-        fprintf(stderr, "Failed to read N_COLS. Aborting...\n");
-        exit(1);
-    }
+    // A binary input file is mapped rather than parsed
+    if (isBinaryInput(INPUT_FILE)) {
+        if (mapBinaryInput(INPUT_FILE, &N_GENERATIONS, &N_ROWS, &N_COLS, &START_WORLD, &N_INVASIONS, &INVASION_TIMES, &INVASION_PLANS) == -1) {
+            exit(1);
+        }
+    } else {
+        // Read nGenerations
+        if (readParam(INPUT_FILE, &line, &len, &N_GENERATIONS) == -1) {
+            fprintf(stderr, "Failed to read N_GENERATIONS. Aborting...\n");
+            exit(EXIT_FAILURE);
+        }
+        // Read nRows
+        if (readParam(INPUT_FILE, &line, &len, &N_ROWS) == -1) {
+            fprintf(stderr, "Failed to read N_ROWS. Aborting...\n");
+            exit(1);
+        }
 
-    if (N_ROWS == 0 || N_COLS == 0) {
-        fprintf(stderr, "N_ROWS or N_COLS is 0. Aborting...\n");
-        exit(1);
-    }
+        // Read nCols
+        if (readParam(INPUT_FILE, &line, &len, &N_COLS) == -1) {
+            fprintf(stderr, "Failed to read N_COLS. Aborting...\n");
+            exit(1);
+        }
 
-    // Read start world
-    START_WORLD = (int *) malloc(sizeof(int) * N_ROWS * N_COLS);
-    if (START_WORLD == NULL || readWorldLayout(INPUT_FILE, &line, &len, START_WORLD, N_ROWS, N_COLS) == -1)
-    {
-        fprintf(stderr, "Failed to read START_WORLD. Aborting...\n");
-        exit(1);
-    }
+        if (N_ROWS == 0 || N_COLS == 0) {
+            fprintf(stderr, "N_ROWS or N_COLS is 0. Aborting...\n");
+            exit(1);
+        }
 
-    // Read nInvasions
-    if (readParam(INPUT_FILE, &line, &len, &N_INVASIONS) == -1)
-    {
-        fprintf(stderr, "Failed to read N_INVASIONS. Aborting...\n");
-        exit(1);
-    }
+        // Read start world
+        START_WORLD = (int *) malloc(sizeof(int) * N_ROWS * N_COLS);
+        if (START_WORLD == NULL || readWorldLayout(INPUT_FILE, &line, &len, START_WORLD, N_ROWS, N_COLS) == -1)
+        {
+            fprintf(stderr, "Failed to read START_WORLD. Aborting...\n");
+            exit(1);
+        }
 
-    // Read invasions
-    INVASION_TIMES = (int *) malloc(sizeof(int) * N_INVASIONS);
-    INVASION_PLANS = (int **) malloc(sizeof(int *) * N_INVASIONS);
-    if (INVASION_TIMES == NULL || INVASION_PLANS == NULL)
-    {
-        fprintf(stderr, "No memory for invasions. Aborting...\n");
-        exit(1);
-    }
-    for (int i = 0; i < N_INVASIONS; i++)
-    {
-        if (INVASION_TIMES == NULL || readParam(INPUT_FILE, &line, &len, INVASION_TIMES + i))
+        // Read nInvasions
+        if (readParam(INPUT_FILE, &line, &len, &N_INVASIONS) == -1)
         {
-            fprintf(stderr, "Failed to read INVASION_TIME. Aborting...\n");
+            fprintf(stderr, "Failed to read N_INVASIONS. Aborting...\n");
             exit(1);
         }
 
-        INVASION_PLANS[i] = (int *) malloc(sizeof(int) * N_ROWS * N_COLS);
-        if (INVASION_PLANS[i] == NULL || readWorldLayout(INPUT_FILE, &line, &len, INVASION_PLANS[i], N_ROWS, N_COLS))
+        // Read invasions
+        INVASION_TIMES = (int *) malloc(sizeof(int) * N_INVASIONS);
+        INVASION_PLANS = (int **) malloc(sizeof(int *) * N_INVASIONS);
+        if (INVASION_TIMES == NULL || INVASION_PLANS == NULL)
         {
-            fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
+            fprintf(stderr, "No memory for invasions. Aborting...\n");
             exit(1);
         }
+        for (int i = 0; i < N_INVASIONS; i++)
+        {
+            if (INVASION_TIMES == NULL || readParam(INPUT_FILE, &line, &len, INVASION_TIMES + i))
+            {
+                fprintf(stderr, "Failed to read INVASION_TIME. Aborting...\n");
+                exit(1);
+            }
+
+            INVASION_PLANS[i] = (int *) malloc(sizeof(int) * N_ROWS * N_COLS);
+            if (INVASION_PLANS[i] == NULL || readWorldLayout(INPUT_FILE, &line, &len, INVASION_PLANS[i], N_ROWS, N_COLS))
+            {
+                fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
+                exit(1);
+            }
+        }
     }
 
     // Close input file
@@ -229,4 +279,135 @@ int readWorldLayout(FILE *fp, char **line, size_t *len, int *world, int nRows, i
     }
 
     return 0;
-}
\ No newline at end of file
+}
+
+// isBinaryInput returns whether fp is an input file of the binary format, i.e. whether it starts with
+// BINARY_INPUT_MAGIC. fp is left at its start.
+bool isBinaryInput(FILE *fp)
+{
+    char magic[sizeof(((BinaryHeader *) NULL)->magic)];
+    bool isBinary = fread(magic, 1, sizeof(magic), fp) == sizeof(magic) && memcmp(magic, BINARY_INPUT_MAGIC, sizeof(magic)) == 0;
+    rewind(fp);
+    return isBinary;
+}
+
+// align8 returns n rounded up to a multiple of 8.
+static inline uint64_t align8(uint64_t n)
+{
+    return (n + 7) & ~(uint64_t) 7;
+}
+
+// isValidPlan returns whether every one of the nInvaders invaders lands a faction on a cell of an nRows by nCols
+// world, and whether they are in row-major order with no cell landed on twice.
+static bool isValidPlan(const Invader *invaders, uint64_t nInvaders, int nRows, int nCols)
+{
+    long last = -1;
+    for (uint64_t i = 0; i < nInvaders; i++)
+    {
+        if (invaders[i].row < 0 || invaders[i].row >= nRows || invaders[i].col < 0 || invaders[i].col >= nCols ||
+            invaders[i].faction <= DEAD_FACTION || invaders[i].faction >= MAX_FACTIONS)
+        {
+            return false;
+        }
+        long cell = (long) invaders[i].row * nCols + invaders[i].col;
+        if (cell <= last)
+        {
+            return false;
+        }
+        last = cell;
+    }
+    return true;
+}
+
+// mapBinaryInput maps fp, an input file of the binary format, and reads it into the world layouts the text reader
+// fills in: the one-byte cells of the start world are widened to ints, and every invasion plan is laid out from
+// its invaders. Nothing is parsed, but the file is checked like a text file would be: its header and invasion index,
+// so that nothing past the end of the file is read, then every cell of its start world and every invader.
+// -1 is returned on error, after printing what went wrong.
+int mapBinaryInput(FILE *fp, int *nGenerations, int *nRows, int *nCols, int **startWorld, int *nInvasions, int **invasionTimes, int ***invasionPlans)
+{
+    struct stat st;
+    if (fstat(fileno(fp), &st) != 0 || (size_t) st.st_size < sizeof(BinaryHeader))
+    {
+        fprintf(stderr, "Failed to read the binary header. Aborting...\n");
+        return -1;
+    }
+    const char *mapping = (const char *) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+    if (mapping == MAP_FAILED)
+    {
+        fprintf(stderr, "Failed to map the binary input. Aborting...\n");
+        return -1;
+    }
+    // all of it is read, starting with the start world
+    madvise((void *) mapping, st.st_size, MADV_SEQUENTIAL);
+
+    const BinaryHeader *header = (const BinaryHeader *) mapping;
+    if (header->version != BINARY_INPUT_VERSION || header->nRows <= 0 || header->nCols <= 0 || header->nInvasions < 0)
+    {
+        fprintf(stderr, "Binary input has an unknown version or invalid sizes. Aborting...\n");
+        munmap((void *) mapping, st.st_size);
+        return -1;
+    }
+    int rows = header->nRows;
+    int cols = header->nCols;
+    int invasions = header->nInvasions;
+    uint64_t timesOffset = align8(sizeof(BinaryHeader));
+    uint64_t indexOffset = align8(timesOffset + sizeof(int32_t) * (uint64_t) invasions);
+    uint64_t worldOffset = align8(indexOffset + sizeof(BinaryInvasion) * (uint64_t) invasions);
+    uint64_t invadersOffset = align8(worldOffset + (uint64_t) rows * cols);
+    *nGenerations = header->nGenerations;
+    *nRows = rows;
+    *nCols = cols;
+    *nInvasions = invasions;
+
+    // the start world is widened as it is checked
+    const uint8_t *world = (const uint8_t *) (mapping + worldOffset);
+    *startWorld = (int *) malloc(sizeof(int) * rows * cols);
+    bool isValid = invadersOffset <= (uint64_t) st.st_size && *startWorld != NULL;
+    for (long i = 0; isValid && i < (long) rows * cols; i++)
+    {
+        isValid = world[i] < MAX_FACTIONS;
+        (*startWorld)[i] = world[i];
+    }
+    if (!isValid)
+    {
+        fprintf(stderr, "Failed to read START_WORLD. Aborting...\n");
+        munmap((void *) mapping, st.st_size);
+        return -1;
+    }
+
+    *invasionTimes = (int *) malloc(sizeof(int) * invasions);
+    *invasionPlans = (int **) malloc(sizeof(int *) * invasions);
+    if (*invasionTimes == NULL || *invasionPlans == NULL)
+    {
+        fprintf(stderr, "No memory for invasions. Aborting...\n");
+        munmap((void *) mapping, st.st_size);
+        return -1;
+    }
+    const int32_t *times = (const int32_t *) (mapping + timesOffset);
+    const BinaryInvasion *index = (const BinaryInvasion *) (mapping + indexOffset);
+    for (int i = 0; i < invasions; i++)
+    {
+        (*invasionTimes)[i] = times[i];
+
+        uint64_t size = index[i].nInvaders * sizeof(Invader);
+        const Invader *invaders = (const Invader *) (mapping + index[i].offset);
+        (*invasionPlans)[i] = (int *) calloc((size_t) rows * cols, sizeof(int));
+        if ((*invasionPlans)[i] == NULL || index[i].offset < invadersOffset || index[i].offset > (uint64_t) st.st_size ||
+            index[i].offset % sizeof(int32_t) != 0 || index[i].nInvaders > (uint64_t) st.st_size / sizeof(Invader) ||
+            index[i].offset + size > (uint64_t) st.st_size || !isValidPlan(invaders, index[i].nInvaders, rows, cols))
+        {
+            fprintf(stderr, "Failed to read INVASION_PLAN. Aborting...\n");
+            munmap((void *) mapping, st.st_size);
+            return -1;
+        }
+        for (uint64_t j = 0; j < index[i].nInvaders; j++)
+        {
+            setValueAt((*invasionPlans)[i], rows, cols, invaders[j].row, invaders[j].col, invaders[j].faction);
+        }
+    }
+
+    // everything has been copied out of the mapping
+    munmap((void *) mapping, st.st_size);
+    return 0;
+}
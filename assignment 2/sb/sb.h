@@ -23,34 +23,37 @@
 /*
  * C String Builder - https://github.com/cavaliercoder/c-stringbuilder
  *
- * sb.c is a simple, non-thread safe String Builder that makes use of a
- * dynamically-allocated linked-list to enable linear time appending and
- * concatenation.
+ * sb.c is a simple, non-thread safe String Builder that appends into one
+ * contiguous buffer, which doubles in size whenever it fills up, so appending
+ * takes amortized linear time and the built string never needs to be copied
+ * out: it can be written straight to a FILE with sb_write.
  */
 
 #ifndef SB_H
 #define SB_H
 
-#define SB_FAILURE				-1
-#define SB_MAX_FRAG_LENGTH		4096
+#include <stdio.h>
 
-typedef struct _StringFragment {
-	struct _StringFragment	*next;
-	int						length;
-	char					*str;
-} StringFragment;
+#define SB_FAILURE				-1
+#define SB_MIN_CAPACITY			64
 
 typedef struct _StringBuilder {
-	struct _StringFragment	*root;
-	struct _StringFragment	*trunk;
-	int						length;
+	char					*str;
+	long					length;
+	long					capacity;
+	/* set once the buffer could not grow; every append fails until sb_reset */
+	int						failed;
 } StringBuilder;
 
 StringBuilder	*sb_create();
 int				sb_empty(StringBuilder *sb);
-int				sb_append(StringBuilder *sb, const char *str);
-int				sb_appendf(StringBuilder *sb, const char *format, ...);
+long			sb_append(StringBuilder *sb, const char *str);
+long			sb_appendn(StringBuilder *sb, const char *str, long length);
+long			sb_appendc(StringBuilder *sb, char c);
+long			sb_appendint(StringBuilder *sb, long value);
+long			sb_appendf(StringBuilder *sb, const char *format, ...);
 char			*sb_concat(StringBuilder *sb);
+int				sb_write(StringBuilder *sb, FILE *fp);
 void 			sb_reset(StringBuilder *sb);
 void			sb_free(StringBuilder *sb);
 